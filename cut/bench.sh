@@ -0,0 +1,21 @@
+# Generates the synthetic corpora (once) and measures cut on them next to
+# the system's cut. The quoted corpora are CSV with quoted fields holding
+# commas, newlines and escaped quotes, and are cut with --csv. Results are
+# printed as JSON; pick sizes with SIZES, e.g.
+#   SIZES="64M 1G" ./bench.sh > results.json
+mkdir -p bin corpus
+clang -O2 main.c -o bin/cut -pthread
+clang -O2 bench/main.c -o bin/bench
+files=""
+for shape in tsv:2 tsv:10 tsv:100 tsv:500 csv:10 csv:100 quoted:10 quoted:100; do
+    format=${shape%:*}
+    columns=${shape#*:}
+    for size in ${SIZES:-64M}; do
+        file="corpus/$format-$columns-$size"
+        if [ ! -f "$file" ]; then
+            ./bin/bench gen "$format" "$columns" "$size" "$file"
+        fi
+        files="$files $file"
+    done
+done
+./bin/bench run ./bin/cut "$(command -v cut)" $files
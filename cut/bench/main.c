@@ -0,0 +1,599 @@
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAS_TSC
+#endif
+
+#define WRITE_BUFFER_SIZE (1 << 20)
+#define FEED_BUFFER_SIZE (1 << 20)
+#define MIN_COLUMNS 2
+#define MAX_COLUMNS 500
+#define MAX_ARGS 8
+#define MAX_JOBS 256
+#define RUNS 3
+#define SEED 0x9E3779B97F4A7C15ULL
+
+// Deterministic xorshift64* generator, so a corpus of a given shape and
+// size is byte-for-byte the same on every machine.
+typedef struct rng {
+	uint64_t state;
+} rng;
+
+typedef struct corpus_writer {
+	FILE *file;
+	char *buffer;
+	size_t len;
+	uint64_t written;
+	uint64_t size;
+} corpus_writer;
+
+// How a cut is run: on a named (and so mapped) file, with -j over one,
+// or reading the file through a pipe.
+typedef enum variant {
+	MMAP_VARIANT,
+	PARALLEL_VARIANT,
+	PIPE_VARIANT,
+} variant;
+
+typedef struct selection {
+	char name[16];
+	char list[16];
+	char bytes;
+	char csv;
+} selection;
+
+typedef struct measurement {
+	double seconds;
+	uint64_t cycles;
+	char cycles_source[8];
+	long peak_rss_kb;
+	char ok;
+} measurement;
+
+uint64_t next_random(rng *);
+uint64_t random_below(rng *, uint64_t);
+
+uint64_t read_size(char *);
+int read_columns(char *);
+void generate(char, int, uint64_t, char, char *);
+char write_bytes(corpus_writer *, const char *, size_t);
+char write_header(corpus_writer *, int);
+char write_record(corpus_writer *, rng *, char, int);
+char write_quoted_record(corpus_writer *, rng *, int);
+
+void run(char *, char *, int, char **);
+char read_shape(char *, char *, int *, char *);
+int build_selections(selection *, int, char);
+void report(char *, uint64_t, int, selection *, char *, const char *, measurement, char *);
+measurement measure_best(char **, char *);
+measurement measure(char **, char *);
+void feed(char *, int);
+char start_cycle_counter(int *, pid_t);
+double now();
+
+int str_len(char *);
+int str_compare(char *, char *);
+
+const char *variant_names[] = { "mmap", "parallel", "pipe" };
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		fprintf(stderr, "cccut-bench error: missing command, expected 'gen' or 'run'.\n");
+		exit(1);
+	}
+	char *command = *(argv + 1);
+	if (str_compare(command, "gen")) {
+		if (argc != 6) {
+			fprintf(stderr, "cccut-bench error: expected 'gen <tsv|csv|quoted> <columns> <size> <path>'.\n");
+			exit(1);
+		}
+		char *format = *(argv + 2);
+		if (!str_compare(format, "tsv") && !str_compare(format, "csv") && !str_compare(format, "quoted")) {
+			fprintf(stderr, "cccut-bench error: invalid format '%s'.\n", format);
+			exit(1);
+		}
+		int columns = read_columns(*(argv + 3));
+		if (columns == 0) {
+			fprintf(stderr, "cccut-bench error: invalid column count '%s', expected %d to %d.\n", *(argv + 3), MIN_COLUMNS, MAX_COLUMNS);
+			exit(1);
+		}
+		uint64_t size = read_size(*(argv + 4));
+		if (size == 0) {
+			fprintf(stderr, "cccut-bench error: invalid size '%s'.\n", *(argv + 4));
+			exit(1);
+		}
+		generate(*format == 't' ? '\t' : ',', columns, size, *format == 'q', *(argv + 5));
+	} else if (str_compare(command, "run")) {
+		if (argc < 5) {
+			fprintf(stderr, "cccut-bench error: expected 'run <cut> <reference cut> <file>...'.\n");
+			exit(1);
+		}
+		run(*(argv + 2), *(argv + 3), argc - 4, argv + 4);
+	} else {
+		fprintf(stderr, "cccut-bench error: invalid command '%s', expected 'gen' or 'run'.\n", command);
+		exit(1);
+	}
+	return 0;
+}
+
+uint64_t next_random(rng *rng) {
+	rng->state ^= rng->state >> 12;
+	rng->state ^= rng->state << 25;
+	rng->state ^= rng->state >> 27;
+	return rng->state * 0x2545F4914F6CDD1DULL;
+}
+
+uint64_t random_below(rng *rng, uint64_t n) {
+	return next_random(rng) % n;
+}
+
+// Sizes are plain byte counts with an optional K, M or G suffix (powers
+// of 1024). Returns 0 for anything malformed.
+uint64_t read_size(char *arg) {
+	uint64_t size = 0;
+	char *c = arg;
+	for (; *c >= '0' && *c <= '9'; c++) {
+		size = size * 10 + (*c - '0');
+	}
+	if (*c == 'K' || *c == 'k') {
+		size <<= 10;
+		c++;
+	} else if (*c == 'M' || *c == 'm') {
+		size <<= 20;
+		c++;
+	} else if (*c == 'G' || *c == 'g') {
+		size <<= 30;
+		c++;
+	}
+	return c == arg || *c != '\0' ? 0 : size;
+}
+
+// Returns 0 unless arg is a column count in the supported range.
+int read_columns(char *arg) {
+	int columns = 0;
+	char *c = arg;
+	for (; *c >= '0' && *c <= '9' && columns <= MAX_COLUMNS; c++) {
+		columns = columns * 10 + (*c - '0');
+	}
+	return c == arg || *c != '\0' || columns < MIN_COLUMNS || columns > MAX_COLUMNS ? 0 : columns;
+}
+
+// A quoted corpus is CSV under a plain header row, so its shape can still
+// be read from the first line.
+void generate(char delimiter, int columns, uint64_t size, char quoted, char *path) {
+	corpus_writer writer;
+	writer.file = fopen(path, "wb");
+	if (writer.file == NULL) {
+		fprintf(stderr, "cccut-bench error: cannot create '%s'.\n", path);
+		exit(1);
+	}
+	writer.buffer = (char *)malloc(WRITE_BUFFER_SIZE);
+	writer.len = 0;
+	writer.written = 0;
+	writer.size = size;
+	rng rng = { SEED + columns * 2 + (delimiter == ',') + quoted * 2 * (MAX_COLUMNS + 1) };
+	if (quoted) {
+		if (write_header(&writer, columns)) {
+			while (write_quoted_record(&writer, &rng, columns));
+		}
+	} else {
+		while (write_record(&writer, &rng, delimiter, columns));
+	}
+	fwrite(writer.buffer, sizeof(char), writer.len, writer.file);
+	fclose(writer.file);
+	free(writer.buffer);
+}
+
+// Appends to the corpus, cutting the last write short at the target size.
+// Returns 0 once the corpus is complete.
+char write_bytes(corpus_writer *writer, const char *bytes, size_t len) {
+	if (writer->written + len > writer->size) {
+		len = writer->size - writer->written;
+	}
+	if (writer->len + len > WRITE_BUFFER_SIZE) {
+		fwrite(writer->buffer, sizeof(char), writer->len, writer->file);
+		writer->len = 0;
+	}
+	memcpy(writer->buffer + writer->len, bytes, len);
+	writer->len += len;
+	writer->written += len;
+	return writer->written < writer->size;
+}
+
+// One record of numbers and words. Each record draws its own field width
+// (up to 4 or up to 32 characters), so line lengths vary by an order of
+// magnitude within a corpus of a fixed column count.
+char write_record(corpus_writer *writer, rng *rng, char delimiter, int columns) {
+	const char *letters = "abcdefghijklmnopqrstuvwxyz0123456789";
+	char field[32];
+	uint64_t max_width = random_below(rng, 4) == 0 ? 32 : 4;
+	for (int i = 0; i < columns; i++) {
+		size_t width = 1 + random_below(rng, max_width);
+		for (size_t j = 0; j < width; j++) {
+			*(field + j) = *(letters + random_below(rng, 36));
+		}
+		char separator = i == columns - 1 ? '\n' : delimiter;
+		if (!write_bytes(writer, field, width) || !write_bytes(writer, &separator, 1)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+char write_header(corpus_writer *writer, int columns) {
+	char name[16];
+	for (int i = 0; i < columns; i++) {
+		int len = snprintf(name, sizeof(name), "c%d%c", i + 1, i == columns - 1 ? '\n' : ',');
+		if (!write_bytes(writer, name, len)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// Like write_record, but a quarter of the fields are quoted, and one in
+// eight characters of a quoted field is a comma, a newline or an escaped
+// quote, so records span lines and quotes stay open across blocks.
+char write_quoted_record(corpus_writer *writer, rng *rng, int columns) {
+	const char *letters = "abcdefghijklmnopqrstuvwxyz0123456789";
+	const char *specials = ",\n\"";
+	char field[2 * 32 + 2];
+	uint64_t max_width = random_below(rng, 4) == 0 ? 32 : 4;
+	for (int i = 0; i < columns; i++) {
+		size_t width = 1 + random_below(rng, max_width);
+		size_t len = 0;
+		char quoted = random_below(rng, 4) == 0;
+		if (quoted) {
+			*(field + len++) = '"';
+		}
+		for (size_t j = 0; j < width; j++) {
+			char c = quoted && random_below(rng, 8) == 0 ? *(specials + random_below(rng, 3)) : *(letters + random_below(rng, 36));
+			*(field + len++) = c;
+			if (c == '"') {
+				*(field + len++) = '"';
+			}
+		}
+		if (quoted) {
+			*(field + len++) = '"';
+		}
+		char separator = i == columns - 1 ? '\n' : ',';
+		if (!write_bytes(writer, field, len) || !write_bytes(writer, &separator, 1)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// Runs every selection the shape of each file allows, in every variant,
+// and the reference cut on the named file. Keeps the fastest of RUNS runs
+// and prints one JSON object per measurement. Fields of a quoted corpus
+// are cut with --csv; the reference has no such option and splits them
+// at every comma.
+void run(char *cut_path, char *reference_path, int files_count, char **files) {
+	char jobs[16];
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	snprintf(jobs, sizeof(jobs), "-j%d", cpus < 2 ? 2 : cpus > MAX_JOBS ? MAX_JOBS : (int)cpus);
+	printf("[\n");
+	char first = 1;
+	for (int i = 0; i < files_count; i++) {
+		char *file = *(files + i);
+		struct stat st;
+		char delimiter;
+		int columns;
+		char quoted;
+		if (stat(file, &st) != 0) {
+			fprintf(stderr, "cccut-bench error: file '%s' does not exist.\n", file);
+			exit(1);
+		}
+		if (!read_shape(file, &delimiter, &columns, &quoted)) {
+			fprintf(stderr, "cccut-bench error: '%s' is not a TSV or CSV corpus.\n", file);
+			exit(1);
+		}
+		char delimiter_arg[4] = { '-', 'd', delimiter, '\0' };
+		selection selections[6];
+		int count = build_selections(selections, columns, quoted);
+		for (int j = 0; j < count; j++) {
+			selection *s = selections + j;
+			char *args[MAX_ARGS];
+			int n;
+			for (int v = MMAP_VARIANT; v <= PIPE_VARIANT; v++) {
+				n = 0;
+				args[n++] = cut_path;
+				if (v == PARALLEL_VARIANT) {
+					args[n++] = jobs;
+				}
+				if (!s->bytes) {
+					args[n++] = delimiter_arg;
+				}
+				if (s->csv) {
+					args[n++] = "--csv";
+				}
+				args[n++] = s->list;
+				args[n++] = v == PIPE_VARIANT ? NULL : file;
+				args[n] = NULL;
+				measurement m = measure_best(args, v == PIPE_VARIANT ? file : NULL);
+				report(file, st.st_size, columns, s, "cccut", *(variant_names + v), m, &first);
+			}
+			selection plain = *s;
+			plain.csv = 0;
+			n = 0;
+			args[n++] = reference_path;
+			if (!s->bytes) {
+				args[n++] = delimiter_arg;
+			}
+			args[n++] = s->list;
+			args[n++] = file;
+			args[n] = NULL;
+			report(file, st.st_size, columns, &plain, "reference", "file", measure_best(args, NULL), &first);
+		}
+	}
+	printf("\n]\n");
+}
+
+// The delimiter is a tab if the first line has one, a comma otherwise;
+// every record of a generated corpus has the same number of columns. A
+// corpus is quoted if a quote shows up within its first FEED_BUFFER_SIZE
+// bytes.
+char read_shape(char *file, char *delimiter, int *columns, char *quoted) {
+	FILE *f = fopen(file, "rb");
+	if (f == NULL) {
+		return 0;
+	}
+	int tabs = 0;
+	int commas = 0;
+	int c;
+	while ((c = fgetc(f)) != EOF && c != '\n') {
+		tabs += c == '\t';
+		commas += c == ',';
+	}
+	*quoted = 0;
+	for (int i = 0; i < FEED_BUFFER_SIZE && !*quoted && (c = fgetc(f)) != EOF; i++) {
+		*quoted = c == '"';
+	}
+	fclose(f);
+	*delimiter = tabs > 0 ? '\t' : ',';
+	*columns = (tabs > 0 ? tabs : commas) + 1;
+	return *columns >= MIN_COLUMNS;
+}
+
+// The first field, a short prefix, field 100 when there is one, the last
+// field, and a byte and a character range.
+int build_selections(selection *selections, int columns, char quoted) {
+	int count = 0;
+	snprintf((selections + count)->name, 16, "first");
+	snprintf((selections + count)->list, 16, "-f1");
+	(selections + count++)->bytes = 0;
+	snprintf((selections + count)->name, 16, "prefix");
+	snprintf((selections + count)->list, 16, "-f1-3");
+	(selections + count++)->bytes = 0;
+	if (columns >= 100) {
+		snprintf((selections + count)->name, 16, "field100");
+		snprintf((selections + count)->list, 16, "-f100");
+		(selections + count++)->bytes = 0;
+	}
+	snprintf((selections + count)->name, 16, "last");
+	snprintf((selections + count)->list, 16, "-f%d", columns);
+	(selections + count++)->bytes = 0;
+	for (int i = 0; i < count; i++) {
+		(selections + i)->csv = quoted;
+	}
+	snprintf((selections + count)->name, 16, "bytes");
+	snprintf((selections + count)->list, 16, "-b1-64");
+	(selections + count)->csv = 0;
+	(selections + count++)->bytes = 1;
+	snprintf((selections + count)->name, 16, "chars");
+	snprintf((selections + count)->list, 16, "-c1-64");
+	(selections + count)->csv = 0;
+	(selections + count++)->bytes = 1;
+	return count;
+}
+
+void report(char *file, uint64_t bytes, int columns, selection *s, char *tool, const char *variant, measurement m, char *first) {
+	printf("%s  {\"file\": \"%s\", \"bytes\": %" PRIu64 ", \"columns\": %d, \"selection\": \"%s\", \"list\": \"%s\", \"csv\": %s, ",
+	       *first ? "" : ",\n", file, bytes, columns, s->name, s->list, s->csv ? "true" : "false");
+	printf("\"tool\": \"%s\", \"variant\": \"%s\", \"seconds\": %.6f, \"gb_per_s\": %.3f, ",
+	       tool, variant, m.seconds, m.seconds > 0 ? bytes / m.seconds / 1e9 : 0.0);
+	if (*m.cycles_source != '\0' && bytes > 0) {
+		printf("\"cycles_per_byte\": %.3f, \"cycles_source\": \"%s\", ", m.cycles / (double)bytes, m.cycles_source);
+	} else {
+		printf("\"cycles_per_byte\": null, \"cycles_source\": null, ");
+	}
+	printf("\"peak_rss_kb\": %ld}", m.peak_rss_kb);
+	fflush(stdout);
+	*first = 0;
+}
+
+measurement measure_best(char **args, char *piped_file) {
+	measurement best;
+	best.ok = 0;
+	for (int k = 0; k < RUNS; k++) {
+		measurement m = measure(args, piped_file);
+		if (!m.ok) {
+			fprintf(stderr, "cccut-bench error: '%s %s' failed.\n", *args, *(args + 1));
+			exit(1);
+		}
+		if (!best.ok || m.seconds < best.seconds) {
+			long peak_rss_kb = best.ok && best.peak_rss_kb > m.peak_rss_kb ? best.peak_rss_kb : m.peak_rss_kb;
+			best = m;
+			best.peak_rss_kb = peak_rss_kb;
+		}
+	}
+	return best;
+}
+
+// Runs cut once with its output discarded; with piped_file, its input is
+// that file written into a pipe by a feeder process. The child waits on a
+// pipe until the cycle counter is attached, so only cut itself is
+// measured.
+measurement measure(char **args, char *piped_file) {
+	measurement m;
+	memset(&m, 0, sizeof(m));
+	int go[2];
+	int input[2] = { -1, -1 };
+	if (pipe(go) != 0 || (piped_file != NULL && pipe(input) != 0)) {
+		return m;
+	}
+	pid_t feeder = -1;
+	if (piped_file != NULL) {
+		feeder = fork();
+		if (feeder == 0) {
+			close(*go);
+			close(*(go + 1));
+			close(*input);
+			feed(piped_file, *(input + 1));
+			_exit(0);
+		}
+		close(*(input + 1));
+	}
+	pid_t pid = fork();
+	if (pid == 0) {
+		char byte;
+		close(*(go + 1));
+		if (read(*go, &byte, 1) < 0) {
+			_exit(127);
+		}
+		int null_fd = open("/dev/null", O_WRONLY);
+		dup2(null_fd, STDOUT_FILENO);
+		if (piped_file != NULL) {
+			dup2(*input, STDIN_FILENO);
+			close(*input);
+		}
+		execv(*args, args);
+		_exit(127);
+	}
+	close(*go);
+	if (piped_file != NULL) {
+		close(*input);
+	}
+	int perf_fd = -1;
+	char has_perf = start_cycle_counter(&perf_fd, pid);
+#ifdef HAS_TSC
+	uint64_t tsc_start = __rdtsc();
+#endif
+	double start = now();
+	if (write(*(go + 1), "g", 1) < 0) {
+		close(*(go + 1));
+		return m;
+	}
+	close(*(go + 1));
+	int status;
+	struct rusage usage;
+	if (wait4(pid, &status, 0, &usage) < 0) {
+		return m;
+	}
+	m.seconds = now() - start;
+#ifdef HAS_TSC
+	uint64_t tsc_cycles = __rdtsc() - tsc_start;
+#endif
+	if (feeder > 0) {
+		waitpid(feeder, NULL, 0);
+	}
+	m.peak_rss_kb = usage.ru_maxrss;
+	m.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	if (has_perf && read(perf_fd, &m.cycles, sizeof(m.cycles)) == sizeof(m.cycles)) {
+		strcpy(m.cycles_source, "perf");
+	}
+#ifdef HAS_TSC
+	else {
+		m.cycles = tsc_cycles;
+		strcpy(m.cycles_source, "tsc");
+	}
+#endif
+	if (perf_fd >= 0) {
+		close(perf_fd);
+	}
+	return m;
+}
+
+void feed(char *file, int fd) {
+	int in = open(file, O_RDONLY);
+	if (in < 0) {
+		return;
+	}
+	char *buffer = (char *)malloc(FEED_BUFFER_SIZE);
+	ssize_t len;
+	while ((len = read(in, buffer, FEED_BUFFER_SIZE)) > 0) {
+		ssize_t written = 0;
+		while (written < len) {
+			ssize_t n = write(fd, buffer + written, len - written);
+			if (n <= 0) {
+				free(buffer);
+				close(in);
+				return;
+			}
+			written += n;
+		}
+	}
+	free(buffer);
+	close(in);
+}
+
+// Counts the child's CPU cycles (and its threads') from exec onwards.
+// Kernels that forbid perf events leave us with the time stamp counter.
+char start_cycle_counter(int *perf_fd, pid_t pid) {
+#ifdef __linux__
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.disabled = 1;
+	attr.enable_on_exec = 1;
+	attr.inherit = 1;
+	attr.exclude_hv = 1;
+	*perf_fd = syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+	if (*perf_fd < 0) {
+		attr.exclude_kernel = 1;
+		*perf_fd = syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+	}
+	return *perf_fd >= 0;
+#else
+	(void)pid;
+	*perf_fd = -1;
+	return 0;
+#endif
+}
+
+double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int str_len(char *str) {
+	int len = 0;
+	while (*(str + len) != '\0') {
+		len++;
+	}
+	return len;
+}
+
+int str_compare(char *str1, char *str2) {
+	int len1 = str_len(str1);
+	int len2 = str_len(str2);
+	if (len1 != len2) {
+		return 0;
+	}
+	for (int i = 0; i < len1; i++) {
+		if (*(str1 + i) != *(str2 + i)) {
+			return 0;
+		}
+	}
+	return 1;
+}
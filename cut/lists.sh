@@ -0,0 +1,37 @@
+# Runs cut with lists at the edges of what is valid and compares the
+# output and whether it fails with the system's cut.
+mkdir -p bin corpus
+clang -O2 main.c -o bin/cut -pthread
+printf 'a,b,c\nabcdefgh\n' > corpus/lists
+failed=0
+while read -r options; do
+    expected=$(cut $options corpus/lists 2> /dev/null)
+    expected_status=$?
+    got=$(./bin/cut $options corpus/lists 2> /dev/null)
+    status=$?
+    if [ "$got" != "$expected" ] || [ "$((status == 0))" != "$((expected_status == 0))" ]; then
+        echo "cut $options printed '$got' (status $status), expected '$expected' (status $expected_status)"
+        failed=1
+    fi
+done << 'EOF'
+-d, -f 18446744073709551617
+-d, -f 18446744073709551616
+-b 18446744073709551617
+-d, -f -
+-d, -f 1,-
+-b -
+-d, -f -2
+-d, -f 2-
+-d, -f 99999999999999
+-d, -f 1-99999999999
+-d, -f 2,3-99999999999
+-b 1-3,4-5 --output-delimiter=:
+-b 4-5,1-3,6- --output-delimiter=:
+-b 1-3,2-5 --output-delimiter=:
+-c 1,2,3-4 --output-delimiter=:
+-b 1-3,4-5
+EOF
+if [ "$failed" = 0 ]; then
+    echo "all lists agree"
+fi
+exit "$failed"
@@ -0,0 +1,44 @@
+# Cuts a file of long lines (most fields past the size at which slices of
+# the mapping are queued instead of copied) and compares the output with
+# the system's cut, written both to a regular file and to a pipe.
+mkdir -p bin corpus
+clang -O2 main.c -o bin/cut -pthread
+file=corpus/longlines
+if [ ! -f "$file" ]; then
+    awk 'function repeat(c, n,    s) {
+        s = "";
+        while (n-- > 0) {
+            s = s c;
+        }
+        return s;
+    }
+    BEGIN {
+        srand(3);
+        for (i = 0; i < 4000; i++) {
+            line = "";
+            for (j = 0; j < 3; j++) {
+                n = 1 + int(rand() * (j == 1 ? 12000 : 6000));
+                field = repeat(substr("abc", j + 1, 1), n);
+                line = line (j > 0 ? "\t" : "") field;
+            }
+            print (rand() < 0.1 ? line "\t" : line);
+        }
+    }' > "$file"
+fi
+failed=0
+for options in "-s -f2" "-f2-" "-f1,3" "-b5000-" "-b1-" "-c4097-"; do
+    cut $options "$file" > corpus/expected
+    if ! ./bin/cut -j1 $options "$file" > corpus/got || ! cmp -s corpus/expected corpus/got; then
+        echo "cut $options fails or differs when writing to a file"
+        failed=1
+    fi
+    { ./bin/cut -j1 $options "$file"; echo $? > corpus/status; } | cat > corpus/got
+    if [ "$(cat corpus/status)" != 0 ] || ! cmp -s corpus/expected corpus/got; then
+        echo "cut $options fails or differs when writing to a pipe"
+        failed=1
+    fi
+done
+if [ "$failed" = 0 ]; then
+    echo "all outputs agree"
+fi
+exit "$failed"
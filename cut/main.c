@@ -1,60 +1,1389 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
-const size_t BUFFER_SIZE = 1024;
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAS_X86_KERNELS
+#endif
 
+#define BUFFER_SIZE (1 << 20)
+#define BUFFER_ALIGNMENT 64
+#define WRITE_BUFFER_SIZE (1 << 20)
+#define MAX_JOBS 256
+#define MIN_CHUNK_SIZE (1 << 20)
+#define MAX_CHUNK_SIZE (1 << 24)
+#define MAX_VECTORS 1024
+#define ZERO_COPY_MIN 4096
+#define QUOTE '"'
+#define OPEN_RANGE SIZE_MAX
+#define MAX_BITMAP_FIELDS (1 << 20)
+#define NO_FIELD SIZE_MAX
+
+// Regular files are mapped and the whole file becomes the buffer; pipes
+// and stdin are read in large aligned blocks instead.
 typedef struct file_stream_reader {
 	size_t buffer_pos;
 	size_t buffer_size;
-	char buffer[BUFFER_SIZE];
-	FILE *file;
+	size_t buffer_alloc;
+	char *buffer;
+	char mapped;
+	char eof;
+	int fd;
 } file_stream_reader;
 
+// Output is gathered in a large buffer and handed to write(2) in one go,
+// rather than going through stdio a byte at a time. A writer without a
+// descriptor (fd < 0) never flushes; its buffer grows to hold everything.
+//
+// While source is set (a mapped input), large slices of it are not copied:
+// the buffered bytes before them (from segment on) and the slices
+// themselves are queued as iovecs and flushed with writev(2), or with
+// vmsplice(2) for the slices when the output is a pipe.
+typedef struct file_stream_writer {
+	int fd;
+	size_t len;
+	size_t alloc;
+	char *buffer;
+	const char *source;
+	size_t source_len;
+	struct iovec *vectors;
+	int vector_count;
+	size_t segment;
+	char pipe;
+} file_stream_writer;
+
+typedef enum cut_mode {
+	NO_MODE,
+	BYTES_MODE,
+	CHARS_MODE,
+	FIELDS_MODE,
+} cut_mode;
+
+// A 1-based, inclusive range of positions; hi is OPEN_RANGE for "N-".
+typedef struct range {
+	size_t lo;
+	size_t hi;
+} range;
+
+// Sorted, non-overlapping ranges parsed from a list such as "1,3-5,7-".
+typedef struct range_list {
+	range *ranges;
+	int count;
+} range_list;
+
+// How -f selects fields, decided once from the range list. The common
+// shapes get their own loops; anything else tests a bitmap per field.
+typedef enum field_plan {
+	SINGLE_FIELD_PLAN,
+	PREFIX_PLAN,
+	SUFFIX_PLAN,
+	BITMAP_PLAN,
+} field_plan;
+
+// Sets one bit per delimiter, per newline and, when asked for, per quote
+// in (up to) 64 bytes.
+typedef void (*separator_kernel)(const char *, size_t, char, uint64_t *, uint64_t *, uint64_t *);
+
+typedef struct cut_options {
+	cut_mode mode;
+	range_list list;
+	char delimiter;
+	char *output_delimiter;
+	size_t output_delimiter_len;
+	char only_delimited;
+	field_plan plan;
+	size_t plan_field;
+	uint64_t *bitmap;
+	size_t last_field;
+	size_t open_from;
+	char contiguous;
+	separator_kernel find_separators;
+	int jobs;
+	char csv;
+} cut_options;
+
+// Walks the delimiters and newlines of a span of whole lines in order. The
+// span is classified 64 bytes at a time; block holds the offset of the
+// current block and the masks only the separators not yet handed out.
+// In CSV mode, quoted is all ones while the previous block ended inside
+// quotes, and separators inside quotes never make it into the masks.
+typedef struct separator_scanner {
+	const char *span;
+	size_t len;
+	size_t block;
+	uint64_t delimiters;
+	uint64_t newlines;
+	uint64_t quoted;
+	char delimiter;
+	char csv;
+	separator_kernel find_separators;
+} separator_scanner;
+
+// A line-aligned piece of a mapped file and the output cut from it.
+typedef struct cut_chunk {
+	char *lines;
+	size_t len;
+	file_stream_writer *output;
+	char done;
+} cut_chunk;
+
+// Workers take chunks in order while the calling thread writes finished
+// ones out in the same order. A worker only runs window chunks ahead of
+// the writer, which bounds the output held in memory.
+typedef struct chunk_scheduler {
+	cut_chunk *chunks;
+	size_t count;
+	size_t next;
+	size_t written;
+	size_t window;
+	cut_options *options;
+	pthread_mutex_t lock;
+	pthread_cond_t chunk_done;
+	pthread_cond_t chunk_written;
+} chunk_scheduler;
+
+typedef struct arg_stream {
+	unsigned int argc;
+	unsigned int i;
+	char *arg;
+	char **argv;
+} arg_stream;
+
 file_stream_reader *create_file_stream_reader(char *);
-char peek_byte(file_stream_reader *);
-char next_byte(file_stream_reader *);
+char map_file(int, char **, size_t *);
+char *next_lines(file_stream_reader *, size_t *, size_t);
 void _fill(file_stream_reader *);
+void destroy_file_stream_reader(file_stream_reader *);
+
+file_stream_writer *create_file_stream_writer(int);
+void write_bytes(file_stream_writer *, const char *, size_t);
+void write_byte(file_stream_writer *, char);
+void reserve_output(file_stream_writer *, size_t);
+void queue_slice(file_stream_writer *, const char *, size_t);
+void close_segment(file_stream_writer *);
+void flush_writer(file_stream_writer *);
+void write_vectors(int, struct iovec *, int);
+void splice_slice(int, struct iovec *);
+void destroy_file_stream_writer(file_stream_writer *);
+
+arg_stream *create_arg_stream(unsigned int, char **);
+char *peek_arg(arg_stream *);
+char *next_arg(arg_stream *);
 
-int main() {
-	file_stream_reader *reader = create_file_stream_reader("main.c");
-	while (peek_byte(reader) != EOF) {
-		printf("%c", peek_byte(reader));
-		next_byte(reader);
+void read_options(arg_stream *, cut_options *);
+char *read_option_value(arg_stream *, char *, int);
+range_list parse_range_list(char *, cut_mode, char);
+size_t parse_position(char **, char *, cut_mode);
+int read_number(char *, int);
+int compare_ranges(const void *, const void *);
+void compile_field_plan(cut_options *);
+void compile_field_bitmap(cut_options *);
+
+void cut_file(char *, cut_options *, file_stream_writer *);
+void cut_span(char *, size_t, cut_options *, file_stream_writer *);
+void cut_file_parallel(char *, size_t, cut_options *, file_stream_writer *);
+void *run_chunk_worker(void *);
+void write_chunks(int, cut_chunk *, size_t);
+void cut_lines(char *, size_t, cut_options *, file_stream_writer *);
+void cut_line(char *, size_t, cut_options *, file_stream_writer *);
+void cut_fields(char *, size_t, cut_options *, file_stream_writer *);
+size_t cut_delimited_line(separator_scanner *, size_t, size_t, cut_options *, file_stream_writer *);
+size_t skip_fields(separator_scanner *, size_t *, size_t);
+size_t next_selected_field(cut_options *, size_t);
+size_t cut_fields_bitmap(separator_scanner *, size_t, size_t, cut_options *, file_stream_writer *);
+void cut_bytes(char *, size_t, cut_options *, file_stream_writer *);
+void cut_chars(char *, size_t, cut_options *, file_stream_writer *);
+void write_slice(file_stream_writer *, cut_options *, char *, char *, size_t);
+char is_selected(range_list *, int *, size_t);
+
+void init_scanner(separator_scanner *, const char *, size_t, cut_options *);
+size_t next_separator(separator_scanner *);
+size_t next_newline(separator_scanner *);
+char is_line_end(separator_scanner *, size_t);
+char load_next_block(separator_scanner *);
+void classify_block(separator_scanner *);
+uint64_t prefix_xor(uint64_t);
+char has_open_quote(cut_options *, const char *, size_t);
+separator_kernel select_separator_kernel();
+void find_separators_scalar(const char *, size_t, char, uint64_t *, uint64_t *, uint64_t *);
+#ifdef HAS_X86_KERNELS
+void find_separators_sse2(const char *, size_t, char, uint64_t *, uint64_t *, uint64_t *);
+void find_separators_avx2(const char *, size_t, char, uint64_t *, uint64_t *, uint64_t *);
+#endif
+
+int str_len(char *);
+int str_compare(char *, char *);
+char starts_with(char *, char *);
+
+int main(int argc, char **argv) {
+	arg_stream *args = create_arg_stream(argc, argv);
+	cut_options options;
+	read_options(args, &options);
+	file_stream_writer *writer = create_file_stream_writer(STDOUT_FILENO);
+	if (peek_arg(args) == NULL) {
+		cut_file(NULL, &options, writer);
 	}
+	while (peek_arg(args) != NULL) {
+		char *file_path = next_arg(args);
+		cut_file(str_compare(file_path, "-") ? NULL : file_path, &options, writer);
+	}
+	destroy_file_stream_writer(writer);
+	free(options.list.ranges);
+	free(options.bitmap);
+	free(args);
 	return 0;
 }
 
-file_stream_reader *create_file_stream_reader(char *file_path) {
-	FILE *file = fopen(file_path, "r");
-	if (file == NULL) {
-		fprintf(stderr, "cccut: file \"%s\" does not exist\n", file_path);
+void cut_file(char *file_path, cut_options *options, file_stream_writer *writer) {
+	file_stream_reader *reader = create_file_stream_reader(file_path);
+	char *lines;
+	size_t len;
+	size_t min_len = 0;
+	if (options->jobs > 1 && !options->csv && reader->mapped && reader->buffer_size >= 2 * MIN_CHUNK_SIZE) {
+		cut_file_parallel(reader->buffer, reader->buffer_size, options, writer);
+	} else {
+		if (reader->mapped) {
+			writer->source = reader->buffer;
+			writer->source_len = reader->buffer_size;
+		}
+		while ((lines = next_lines(reader, &len, min_len)) != NULL) {
+			if (options->csv && !reader->mapped && !reader->eof && has_open_quote(options, lines, len)) {
+				// The last newline is inside a quoted field: wait for the
+				// rest of the record.
+				reader->buffer_pos -= len;
+				min_len = len;
+				continue;
+			}
+			min_len = 0;
+			cut_span(lines, len, options, writer);
+		}
+		if (writer->vector_count > 0) {
+			// Queued slices point into the mapping about to be unmapped.
+			flush_writer(writer);
+		}
+		writer->source = NULL;
+	}
+	destroy_file_stream_reader(reader);
+}
+
+void cut_span(char *lines, size_t len, cut_options *options, file_stream_writer *writer) {
+	if (options->mode == FIELDS_MODE) {
+		cut_fields(lines, len, options, writer);
+	} else {
+		cut_lines(lines, len, options, writer);
+	}
+}
+
+// Splits a mapped file into roughly equal chunks, each boundary moved up
+// to just after the next newline, and cuts them on worker threads. Every
+// chunk gets its own output buffer; those are written in file order, so
+// the output is the same as the serial path's.
+void cut_file_parallel(char *lines, size_t len, cut_options *options, file_stream_writer *writer) {
+	size_t count = len / MAX_CHUNK_SIZE + 1;
+	if (count < (size_t)options->jobs) {
+		count = len / MIN_CHUNK_SIZE < (size_t)options->jobs ? len / MIN_CHUNK_SIZE : (size_t)options->jobs;
+	}
+	chunk_scheduler scheduler;
+	scheduler.chunks = (cut_chunk *)malloc(count * sizeof(cut_chunk));
+	scheduler.count = count;
+	scheduler.next = 0;
+	scheduler.written = 0;
+	scheduler.window = 2 * options->jobs;
+	scheduler.options = options;
+	size_t start = 0;
+	for (size_t i = 0; i < count; i++) {
+		size_t end = i + 1 == count ? len : len / count * (i + 1);
+		if (end <= start) {
+			end = start;
+		} else if (end < len) {
+			char *newline = memchr(lines + end - 1, '\n', len - end + 1);
+			end = newline != NULL ? (size_t)(newline - lines) + 1 : len;
+		}
+		cut_chunk *chunk = scheduler.chunks + i;
+		chunk->lines = lines + start;
+		chunk->len = end - start;
+		chunk->output = NULL;
+		chunk->done = 0;
+		start = end;
+	}
+	pthread_mutex_init(&scheduler.lock, NULL);
+	pthread_cond_init(&scheduler.chunk_done, NULL);
+	pthread_cond_init(&scheduler.chunk_written, NULL);
+	int workers = (size_t)options->jobs < count ? options->jobs : (int)count;
+	pthread_t *threads = (pthread_t *)malloc(workers * sizeof(pthread_t));
+	for (int i = 0; i < workers; i++) {
+		if (pthread_create(threads + i, NULL, run_chunk_worker, &scheduler) != 0) {
+			fprintf(stderr, "cccut: could not start a worker thread\n");
+			exit(1);
+		}
+	}
+	flush_writer(writer);
+	pthread_mutex_lock(&scheduler.lock);
+	while (scheduler.written < count) {
+		while (!(scheduler.chunks + scheduler.written)->done) {
+			pthread_cond_wait(&scheduler.chunk_done, &scheduler.lock);
+		}
+		size_t first = scheduler.written;
+		size_t ready = first;
+		while (ready < count && (scheduler.chunks + ready)->done) {
+			ready++;
+		}
+		pthread_mutex_unlock(&scheduler.lock);
+		write_chunks(writer->fd, scheduler.chunks + first, ready - first);
+		pthread_mutex_lock(&scheduler.lock);
+		scheduler.written = ready;
+		pthread_cond_broadcast(&scheduler.chunk_written);
+	}
+	pthread_mutex_unlock(&scheduler.lock);
+	for (int i = 0; i < workers; i++) {
+		pthread_join(*(threads + i), NULL);
+	}
+	pthread_mutex_destroy(&scheduler.lock);
+	pthread_cond_destroy(&scheduler.chunk_done);
+	pthread_cond_destroy(&scheduler.chunk_written);
+	free(threads);
+	free(scheduler.chunks);
+}
+
+void *run_chunk_worker(void *arg) {
+	chunk_scheduler *scheduler = (chunk_scheduler *)arg;
+	pthread_mutex_lock(&scheduler->lock);
+	while (scheduler->next < scheduler->count) {
+		if (scheduler->next >= scheduler->written + scheduler->window) {
+			pthread_cond_wait(&scheduler->chunk_written, &scheduler->lock);
+			continue;
+		}
+		cut_chunk *chunk = scheduler->chunks + scheduler->next++;
+		pthread_mutex_unlock(&scheduler->lock);
+		chunk->output = create_file_stream_writer(-1);
+		reserve_output(chunk->output, chunk->len + 1);
+		cut_span(chunk->lines, chunk->len, scheduler->options, chunk->output);
+		pthread_mutex_lock(&scheduler->lock);
+		chunk->done = 1;
+		pthread_cond_signal(&scheduler->chunk_done);
+	}
+	pthread_mutex_unlock(&scheduler->lock);
+	return NULL;
+}
+
+// Hands the outputs of finished chunks to writev(2), MAX_VECTORS at a
+// time, and frees them.
+void write_chunks(int fd, cut_chunk *chunks, size_t count) {
+	struct iovec vectors[count < MAX_VECTORS ? count : MAX_VECTORS];
+	size_t i = 0;
+	while (i < count) {
+		int n = 0;
+		for (; i < count && n < MAX_VECTORS; i++) {
+			if ((chunks + i)->output->len > 0) {
+				vectors[n].iov_base = (chunks + i)->output->buffer;
+				vectors[n].iov_len = (chunks + i)->output->len;
+				n++;
+			}
+		}
+		write_vectors(fd, vectors, n);
+	}
+	for (size_t j = 0; j < count; j++) {
+		destroy_file_stream_writer((chunks + j)->output);
+	}
+}
+
+void cut_lines(char *lines, size_t len, cut_options *options, file_stream_writer *writer) {
+	char *end = lines + len;
+	char *line = lines;
+	while (line < end) {
+		char *newline = memchr(line, '\n', end - line);
+		if (newline == NULL) {
+			newline = end;
+		}
+		cut_line(line, newline - line, options, writer);
+		line = newline + 1;
+	}
+}
+
+void cut_line(char *line, size_t len, cut_options *options, file_stream_writer *writer) {
+	if (options->mode == BYTES_MODE) {
+		cut_bytes(line, len, options, writer);
+	} else {
+		cut_chars(line, len, options, writer);
+	}
+}
+
+// Fields are sliced out of the span by the offsets the scanner hands out.
+// A line without the delimiter is passed through whole, unless -s asked
+// for such lines to be dropped.
+void cut_fields(char *lines, size_t len, cut_options *options, file_stream_writer *writer) {
+	separator_scanner scanner;
+	init_scanner(&scanner, lines, len, options);
+	size_t start = 0;
+	while (start < len) {
+		size_t separator = next_separator(&scanner);
+		if (is_line_end(&scanner, separator)) {
+			if (!options->only_delimited) {
+				write_bytes(writer, lines + start, separator - start);
+				write_byte(writer, '\n');
+			}
+		} else {
+			separator = cut_delimited_line(&scanner, start, separator, options, writer);
+			write_byte(writer, '\n');
+		}
+		start = separator + 1;
+	}
+}
+
+// Cuts the line starting at start, whose first field ends at separator.
+// Returns the offset of the end of the line.
+size_t cut_delimited_line(separator_scanner *scanner, size_t start, size_t separator, cut_options *options, file_stream_writer *writer) {
+	const char *lines = scanner->span;
+	size_t field;
+	switch (options->plan) {
+		case SINGLE_FIELD_PLAN:
+			field = options->plan_field == 1 ? start : skip_fields(scanner, &separator, options->plan_field - 1);
+			if (field != NO_FIELD) {
+				write_bytes(writer, lines + field, separator - field);
+			}
+			break;
+		case PREFIX_PLAN:
+			skip_fields(scanner, &separator, options->plan_field - 1);
+			write_bytes(writer, lines + start, separator - start);
+			break;
+		case SUFFIX_PLAN:
+			field = options->plan_field == 1 ? start : skip_fields(scanner, &separator, options->plan_field - 1);
+			if (field != NO_FIELD) {
+				separator = is_line_end(scanner, separator) ? separator : next_newline(scanner);
+				write_bytes(writer, lines + field, separator - field);
+			}
+			break;
+		default:
+			return cut_fields_bitmap(scanner, start, separator, options, writer);
+	}
+	return is_line_end(scanner, separator) ? separator : next_newline(scanner);
+}
+
+// Moves count fields on from the field that ends at *separator. Returns the
+// start of the field reached, with its end left in *separator, or NO_FIELD
+// when the line ends first. Delimiters that come before any newline in the
+// current block are skipped together by their population count.
+size_t skip_fields(separator_scanner *scanner, size_t *separator, size_t count) {
+	size_t field = NO_FIELD;
+	while (count > 0) {
+		if (is_line_end(scanner, *separator)) {
+			return NO_FIELD;
+		}
+		uint64_t newline = scanner->newlines & -scanner->newlines;
+		uint64_t delimiters = newline != 0 ? scanner->delimiters & (newline - 1) : scanner->delimiters;
+		size_t skipped = __builtin_popcountll(delimiters);
+		if (skipped > 0 && skipped < count) {
+			*separator = scanner->block + 63 - __builtin_clzll(delimiters);
+			scanner->delimiters &= ~delimiters;
+			count -= skipped;
+			continue;
+		}
+		field = *separator + 1;
+		*separator = next_separator(scanner);
+		count--;
+	}
+	return field;
+}
+
+// Returns the first selected field from field on, counting the open tail.
+// Lists that reach past MAX_BITMAP_FIELDS have no bitmap and are looked up
+// in the (sorted, merged) ranges instead.
+size_t next_selected_field(cut_options *options, size_t field) {
+	if (options->bitmap == NULL) {
+		for (int i = 0; i < options->list.count; i++) {
+			range *r = options->list.ranges + i;
+			size_t hi = r->hi == OPEN_RANGE ? r->lo - 1 : r->hi;
+			if (field <= hi) {
+				return field > r->lo ? field : r->lo;
+			}
+		}
+		return options->open_from;
+	}
+	while (field <= options->last_field) {
+		uint64_t word = *(options->bitmap + (field - 1) / 64) >> ((field - 1) % 64);
+		if (word != 0) {
+			return field + __builtin_ctzll(word);
+		}
+		field += 64 - (field - 1) % 64;
+	}
+	return options->open_from;
+}
+
+// Selected fields that follow each other are written as one slice when
+// the output delimiter is the input one. Unselected fields are skipped
+// without being looked at, and scanning stops after the last selected
+// field unless the selection is open-ended.
+size_t cut_fields_bitmap(separator_scanner *scanner, size_t start, size_t separator, cut_options *options, file_stream_writer *writer) {
+	const char *lines = scanner->span;
+	char printed = 0;
+	size_t run = NO_FIELD;
+	size_t run_end = 0;
+	size_t field = 1;
+	size_t next = next_selected_field(options, 1);
+	while (next != NO_FIELD) {
+		if (next > field) {
+			start = skip_fields(scanner, &separator, next - field);
+			if (start == NO_FIELD) {
+				break;
+			}
+			field = next;
+		}
+		if (field == options->open_from) {
+			break;
+		}
+		if (run != NO_FIELD && options->contiguous && run_end + 1 == start) {
+			run_end = separator;
+		} else {
+			if (run != NO_FIELD) {
+				write_slice(writer, options, &printed, (char *)lines + run, run_end - run);
+			}
+			run = start;
+			run_end = separator;
+		}
+		if (is_line_end(scanner, separator)) {
+			break;
+		}
+		next = next_selected_field(options, field + 1);
+	}
+	if (field == options->open_from && start != NO_FIELD) {
+		if (run != NO_FIELD && options->contiguous && run_end + 1 == start) {
+			run_end = is_line_end(scanner, separator) ? separator : next_newline(scanner);
+			separator = run_end;
+		} else {
+			if (run != NO_FIELD) {
+				write_slice(writer, options, &printed, (char *)lines + run, run_end - run);
+			}
+			run = start;
+			if (options->contiguous) {
+				separator = is_line_end(scanner, separator) ? separator : next_newline(scanner);
+			} else {
+				// Each remaining field is printed with the output delimiter.
+				while (!is_line_end(scanner, separator)) {
+					write_slice(writer, options, &printed, (char *)lines + run, separator - run);
+					run = separator + 1;
+					separator = next_separator(scanner);
+				}
+			}
+			run_end = separator;
+		}
+	}
+	if (run != NO_FIELD) {
+		write_slice(writer, options, &printed, (char *)lines + run, run_end - run);
+	}
+	return is_line_end(scanner, separator) ? separator : next_newline(scanner);
+}
+
+// Each selected range is copied as one slice.
+void cut_bytes(char *line, size_t len, cut_options *options, file_stream_writer *writer) {
+	char printed = 0;
+	for (int i = 0; i < options->list.count; i++) {
+		range *r = options->list.ranges + i;
+		if (r->lo > len) {
+			break;
+		}
+		size_t hi = r->hi < len ? r->hi : len;
+		write_slice(writer, options, &printed, line + r->lo - 1, hi - r->lo + 1);
+	}
+	write_byte(writer, '\n');
+}
+
+// Like cut_bytes, but positions count UTF-8 characters: a character is a
+// lead byte together with the continuation bytes that follow it.
+// A slice ends with its range, so ranges left unmerged stay apart.
+void cut_chars(char *line, size_t len, cut_options *options, file_stream_writer *writer) {
+	int range = 0;
+	int slice_range = 0;
+	size_t position = 0;
+	char *slice = NULL;
+	char printed = 0;
+	for (size_t i = 0; i <= len; i++) {
+		if (i < len && (*(line + i) & 0xC0) == 0x80) {
+			continue;
+		}
+		char selected = i < len && is_selected(&options->list, &range, ++position);
+		if (slice != NULL && (!selected || range != slice_range)) {
+			write_slice(writer, options, &printed, slice, line + i - slice);
+			slice = NULL;
+		}
+		if (slice == NULL && selected) {
+			slice = line + i;
+			slice_range = range;
+		}
+		if (range >= options->list.count) {
+			break;
+		}
+	}
+	write_byte(writer, '\n');
+}
+
+// Slices after the first are preceded by the output delimiter, if any.
+void write_slice(file_stream_writer *writer, cut_options *options, char *printed, char *slice, size_t len) {
+	if (*printed && options->output_delimiter != NULL) {
+		write_bytes(writer, options->output_delimiter, options->output_delimiter_len);
+	}
+	write_bytes(writer, slice, len);
+	*printed = 1;
+}
+
+// Positions are visited in increasing order, so the current range only
+// ever moves forward.
+char is_selected(range_list *list, int *range, size_t position) {
+	while (*range < list->count && (list->ranges + *range)->hi < position) {
+		(*range)++;
+	}
+	return *range < list->count && (list->ranges + *range)->lo <= position;
+}
+
+void init_scanner(separator_scanner *scanner, const char *span, size_t len, cut_options *options) {
+	scanner->span = span;
+	scanner->len = len;
+	scanner->block = 0;
+	scanner->delimiter = options->delimiter;
+	scanner->find_separators = options->find_separators;
+	scanner->csv = options->csv;
+	scanner->quoted = 0;
+	scanner->delimiters = 0;
+	scanner->newlines = 0;
+	if (len > 0) {
+		classify_block(scanner);
+	}
+}
+
+// Returns the offset of the next delimiter or newline, or the length of
+// the span when there is none left.
+size_t next_separator(separator_scanner *scanner) {
+	while ((scanner->delimiters | scanner->newlines) == 0) {
+		if (!load_next_block(scanner)) {
+			return scanner->len;
+		}
+	}
+	uint64_t bits = scanner->delimiters | scanner->newlines;
+	uint64_t lowest = bits & -bits;
+	scanner->delimiters &= ~lowest;
+	scanner->newlines &= ~lowest;
+	return scanner->block + __builtin_ctzll(bits);
+}
+
+// Like next_separator, but passes over any delimiters before the newline.
+size_t next_newline(separator_scanner *scanner) {
+	while (scanner->newlines == 0) {
+		if (!load_next_block(scanner)) {
+			return scanner->len;
+		}
+	}
+	uint64_t lowest = scanner->newlines & -scanner->newlines;
+	uint64_t consumed = lowest | (lowest - 1);
+	scanner->delimiters &= ~consumed;
+	scanner->newlines &= ~consumed;
+	return scanner->block + __builtin_ctzll(lowest);
+}
+
+// The last line of the input may end at the end of the span instead.
+char is_line_end(separator_scanner *scanner, size_t separator) {
+	return separator == scanner->len || *(scanner->span + separator) == '\n';
+}
+
+char load_next_block(separator_scanner *scanner) {
+	if (scanner->block + 64 >= scanner->len) {
+		scanner->delimiters = 0;
+		scanner->newlines = 0;
+		return 0;
+	}
+	scanner->block += 64;
+	classify_block(scanner);
+	return 1;
+}
+
+// In CSV mode the bytes inside quotes are found as the prefix XOR of the
+// quote bits, carried over from the previous block; an escaped quote ("")
+// toggles twice and so leaves the state alone.
+void classify_block(separator_scanner *scanner) {
+	uint64_t quotes;
+	scanner->find_separators(scanner->span + scanner->block, scanner->len - scanner->block, scanner->delimiter, &scanner->delimiters, &scanner->newlines, scanner->csv ? &quotes : NULL);
+	if (scanner->csv) {
+		uint64_t quoted = prefix_xor(quotes) ^ scanner->quoted;
+		scanner->delimiters &= ~quoted;
+		scanner->newlines &= ~quoted;
+		scanner->quoted = (uint64_t)((int64_t)quoted >> 63);
+	}
+}
+
+// Bit i of the result is the XOR of bits 0 to i.
+uint64_t prefix_xor(uint64_t bits) {
+	bits ^= bits << 1;
+	bits ^= bits << 2;
+	bits ^= bits << 4;
+	bits ^= bits << 8;
+	bits ^= bits << 16;
+	bits ^= bits << 32;
+	return bits;
+}
+
+// Whether a span that starts outside quotes ends inside them.
+char has_open_quote(cut_options *options, const char *span, size_t len) {
+	uint64_t delimiters, newlines, quotes;
+	int count = 0;
+	for (size_t i = 0; i < len; i += 64) {
+		options->find_separators(span + i, len - i, options->delimiter, &delimiters, &newlines, &quotes);
+		count += __builtin_popcountll(quotes);
+	}
+	return count % 2;
+}
+
+separator_kernel select_separator_kernel() {
+#ifdef HAS_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return find_separators_avx2;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return find_separators_sse2;
+	}
+#endif
+	return find_separators_scalar;
+}
+
+void find_separators_scalar(const char *block, size_t len, char delimiter, uint64_t *delimiters, uint64_t *newlines, uint64_t *quotes) {
+	size_t n = len < 64 ? len : 64;
+	uint64_t found_delimiters = 0;
+	uint64_t found_newlines = 0;
+	uint64_t found_quotes = 0;
+	for (size_t i = 0; i < n; i++) {
+		found_delimiters |= (uint64_t)(*(block + i) == delimiter) << i;
+		found_newlines |= (uint64_t)(*(block + i) == '\n') << i;
+		found_quotes |= (uint64_t)(*(block + i) == QUOTE) << i;
+	}
+	*delimiters = found_delimiters;
+	*newlines = found_newlines;
+	if (quotes != NULL) {
+		*quotes = found_quotes;
+	}
+}
+
+#ifdef HAS_X86_KERNELS
+void find_separators_sse2(const char *block, size_t len, char delimiter, uint64_t *delimiters, uint64_t *newlines, uint64_t *quotes) {
+	if (len < 64) {
+		find_separators_scalar(block, len, delimiter, delimiters, newlines, quotes);
+		return;
+	}
+	const __m128i delimiter_bytes = _mm_set1_epi8(delimiter);
+	const __m128i newline_bytes = _mm_set1_epi8('\n');
+	const __m128i quote_bytes = _mm_set1_epi8(QUOTE);
+	uint64_t found_delimiters = 0;
+	uint64_t found_newlines = 0;
+	uint64_t found_quotes = 0;
+	for (int j = 0; j < 4; j++) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(block + j * 16));
+		found_delimiters |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, delimiter_bytes)) << (j * 16);
+		found_newlines |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline_bytes)) << (j * 16);
+		if (quotes != NULL) {
+			found_quotes |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote_bytes)) << (j * 16);
+		}
+	}
+	*delimiters = found_delimiters;
+	*newlines = found_newlines;
+	if (quotes != NULL) {
+		*quotes = found_quotes;
+	}
+}
+
+__attribute__((target("avx2")))
+void find_separators_avx2(const char *block, size_t len, char delimiter, uint64_t *delimiters, uint64_t *newlines, uint64_t *quotes) {
+	if (len < 64) {
+		find_separators_scalar(block, len, delimiter, delimiters, newlines, quotes);
+		return;
+	}
+	const __m256i delimiter_bytes = _mm256_set1_epi8(delimiter);
+	const __m256i newline_bytes = _mm256_set1_epi8('\n');
+	__m256i lo = _mm256_loadu_si256((const __m256i *)block);
+	__m256i hi = _mm256_loadu_si256((const __m256i *)(block + 32));
+	*delimiters = (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, delimiter_bytes))
+		| (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, delimiter_bytes)) << 32;
+	*newlines = (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, newline_bytes))
+		| (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, newline_bytes)) << 32;
+	if (quotes != NULL) {
+		const __m256i quote_bytes = _mm256_set1_epi8(QUOTE);
+		*quotes = (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, quote_bytes))
+			| (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, quote_bytes)) << 32;
+	}
+}
+#endif
+
+void read_options(arg_stream *args, cut_options *options) {
+	options->mode = NO_MODE;
+	options->list.ranges = NULL;
+	options->list.count = 0;
+	options->delimiter = '\t';
+	options->output_delimiter = NULL;
+	options->only_delimited = 0;
+	options->jobs = 1;
+	options->csv = 0;
+	char delimiter_set = 0;
+	char *list = NULL;
+	while (peek_arg(args) != NULL && *peek_arg(args) == '-' && *(peek_arg(args) + 1) != '\0') {
+		char *arg = next_arg(args);
+		if (str_compare(arg, "--")) {
+			break;
+		}
+		if (starts_with(arg, "--output-delimiter")) {
+			options->output_delimiter = read_option_value(args, arg, str_len("--output-delimiter"));
+		} else if (str_compare(arg, "--csv")) {
+			options->csv = 1;
+		} else if (str_compare(arg, "-s") || str_compare(arg, "--only-delimited")) {
+			options->only_delimited = 1;
+		} else if (*(arg + 1) == 'j' || starts_with(arg, "--jobs")) {
+			char *jobs = read_option_value(args, arg, *(arg + 1) == 'j' ? 2 : str_len("--jobs"));
+			options->jobs = read_number(jobs, MAX_JOBS);
+			if (options->jobs < 1) {
+				fprintf(stderr, "cccut: invalid number of jobs '%s'\n", jobs);
+				exit(1);
+			}
+		} else if (*(arg + 1) == 'd') {
+			char *delimiter = read_option_value(args, arg, 2);
+			if (str_len(delimiter) != 1) {
+				fprintf(stderr, "cccut: the delimiter must be a single character\n");
+				exit(1);
+			}
+			options->delimiter = *delimiter;
+			delimiter_set = 1;
+		} else if (*(arg + 1) == 'b' || *(arg + 1) == 'c' || *(arg + 1) == 'f') {
+			if (options->mode != NO_MODE) {
+				fprintf(stderr, "cccut: only one type of list may be specified\n");
+				exit(1);
+			}
+			options->mode = *(arg + 1) == 'b' ? BYTES_MODE : *(arg + 1) == 'c' ? CHARS_MODE : FIELDS_MODE;
+			list = read_option_value(args, arg, 2);
+		} else {
+			fprintf(stderr, "cccut: invalid option '%s'\n", arg);
+			exit(1);
+		}
+	}
+	if (options->mode == NO_MODE) {
+		fprintf(stderr, "cccut: you must specify a list of bytes, characters, or fields\n");
+		exit(1);
+	}
+	if (options->csv && options->mode != FIELDS_MODE) {
+		fprintf(stderr, "cccut: '--csv' only applies to fields\n");
+		exit(1);
+	}
+	if (options->csv && !delimiter_set) {
+		options->delimiter = ',';
+	}
+	options->list = parse_range_list(list, options->mode, options->mode == FIELDS_MODE || options->output_delimiter == NULL);
+	if (options->output_delimiter == NULL && options->mode == FIELDS_MODE) {
+		options->output_delimiter = &options->delimiter;
+		options->output_delimiter_len = 1;
+	} else if (options->output_delimiter != NULL) {
+		options->output_delimiter_len = str_len(options->output_delimiter);
+	}
+	options->bitmap = NULL;
+	if (options->mode == FIELDS_MODE) {
+		compile_field_plan(options);
+		options->find_separators = select_separator_kernel();
+	}
+}
+
+// Accepts "-fLIST", "-f LIST", "--opt=VALUE" and "--opt VALUE"; name_len
+// is the length of the option name inside arg.
+char *read_option_value(arg_stream *args, char *arg, int name_len) {
+	char *value = arg + name_len;
+	if (*value == '=' && *(arg + 1) == '-') {
+		return value + 1;
+	}
+	if (*value != '\0') {
+		return value;
+	}
+	if (peek_arg(args) == NULL) {
+		fprintf(stderr, "cccut: option '%s' requires an argument\n", arg);
+		exit(1);
+	}
+	return next_arg(args);
+}
+
+// Overlapping ranges are merged. Ranges that only touch are merged too
+// unless merge_adjacent is 0, as it is for bytes and characters with an
+// output delimiter, which is written between them.
+range_list parse_range_list(char *list, cut_mode mode, char merge_adjacent) {
+	range_list result;
+	int alloc = 1;
+	for (char *c = list; *c != '\0'; c++) {
+		alloc += *c == ',';
+	}
+	result.ranges = (range *)malloc(alloc * sizeof(range));
+	result.count = 0;
+	char *c = list;
+	while (1) {
+		range r;
+		char open_start = *c == '-';
+		r.lo = open_start ? 1 : parse_position(&c, list, mode);
+		r.hi = r.lo;
+		if (*c == '-') {
+			c++;
+			if (open_start && (*c == ',' || *c == '\0')) {
+				fprintf(stderr, "cccut: invalid range with no endpoint in list '%s'\n", list);
+				exit(1);
+			}
+			r.hi = *c == ',' || *c == '\0' ? OPEN_RANGE : parse_position(&c, list, mode);
+		}
+		if (r.hi < r.lo || (*c != ',' && *c != '\0')) {
+			fprintf(stderr, "cccut: invalid list '%s'\n", list);
+			exit(1);
+		}
+		*(result.ranges + result.count++) = r;
+		if (*c == '\0') {
+			break;
+		}
+		c++;
+	}
+	qsort(result.ranges, result.count, sizeof(range), compare_ranges);
+	int merged = 0;
+	for (int i = 1; i < result.count; i++) {
+		range *last = result.ranges + merged;
+		range *r = result.ranges + i;
+		if (last->hi == OPEN_RANGE || r->lo <= last->hi + merge_adjacent) {
+			if (r->hi > last->hi) {
+				last->hi = r->hi;
+			}
+		} else {
+			*(result.ranges + ++merged) = *r;
+		}
+	}
+	result.count = merged + 1;
+	return result;
+}
+
+// Positions are 1-based; zero and anything non-numeric are rejected, and
+// so is anything that would reach OPEN_RANGE.
+size_t parse_position(char **c, char *list, cut_mode mode) {
+	size_t position = 0;
+	char *start = *c;
+	while (**c >= '0' && **c <= '9') {
+		size_t digit = **c - '0';
+		if (position > (OPEN_RANGE - 1 - digit) / 10) {
+			fprintf(stderr, "cccut: %s number too large in list '%s'\n", mode == FIELDS_MODE ? "field" : mode == BYTES_MODE ? "byte" : "character", list);
+			exit(1);
+		}
+		position = position * 10 + digit;
+		(*c)++;
+	}
+	if (*c == start || position == 0) {
+		fprintf(stderr, "cccut: invalid list '%s'\n", list);
 		exit(1);
 	}
+	return position;
+}
+
+// Picks the field loop for the list. Fields below the open tail (if any)
+// go into a bitmap; fields from open_from on are all selected. When the
+// output delimiter is the input one, consecutive fields are contiguous in
+// the line, so prefix and suffix selections are a single slice.
+void compile_field_plan(cut_options *options) {
+	range_list *list = &options->list;
+	range *first = list->ranges;
+	range *last = list->ranges + list->count - 1;
+	options->contiguous = options->output_delimiter_len == 1 && *options->output_delimiter == options->delimiter;
+	options->open_from = last->hi == OPEN_RANGE ? last->lo : OPEN_RANGE;
+	options->last_field = last->hi == OPEN_RANGE ? last->lo - 1 : last->hi;
+	if (list->count == 1 && first->lo == first->hi) {
+		options->plan = SINGLE_FIELD_PLAN;
+		options->plan_field = first->lo;
+	} else if (list->count == 1 && first->lo == 1 && first->hi != OPEN_RANGE && options->contiguous) {
+		options->plan = PREFIX_PLAN;
+		options->plan_field = first->hi;
+	} else if (list->count == 1 && first->hi == OPEN_RANGE && options->contiguous) {
+		options->plan = SUFFIX_PLAN;
+		options->plan_field = first->lo;
+	} else {
+		options->plan = BITMAP_PLAN;
+		compile_field_bitmap(options);
+	}
+}
+
+// One bit per field below the open tail, unless the list reaches too far
+// for a bitmap to pay off.
+void compile_field_bitmap(cut_options *options) {
+	if (options->last_field > MAX_BITMAP_FIELDS) {
+		return;
+	}
+	size_t words = (options->last_field + 63) / 64;
+	options->bitmap = (uint64_t *)calloc(words > 0 ? words : 1, sizeof(uint64_t));
+	if (options->bitmap == NULL) {
+		fprintf(stderr, "cccut: out of memory\n");
+		exit(1);
+	}
+	for (int i = 0; i < options->list.count; i++) {
+		range *r = options->list.ranges + i;
+		size_t hi = r->hi == OPEN_RANGE ? r->lo - 1 : r->hi;
+		for (size_t field = r->lo; field <= hi; field++) {
+			*(options->bitmap + (field - 1) / 64) |= 1ULL << ((field - 1) % 64);
+		}
+	}
+}
+
+int read_number(char *arg, int max) {
+	int number = 0;
+	if (*arg == '\0') {
+		return -1;
+	}
+	for (char *c = arg; *c != '\0'; c++) {
+		if (*c < '0' || *c > '9') {
+			return -1;
+		}
+		number = number * 10 + (*c - '0');
+		if (number > max) {
+			return -1;
+		}
+	}
+	return number;
+}
+
+int compare_ranges(const void *a, const void *b) {
+	const range *ra = (const range *)a;
+	const range *rb = (const range *)b;
+	return ra->lo < rb->lo ? -1 : ra->lo > rb->lo;
+}
+
+file_stream_reader *create_file_stream_reader(char *file_path) {
+	int fd = STDIN_FILENO;
+	if (file_path != NULL) {
+		fd = open(file_path, O_RDONLY);
+		if (fd < 0) {
+			fprintf(stderr, "cccut: file \"%s\" does not exist\n", file_path);
+			exit(1);
+		}
+	}
 	file_stream_reader *reader = (file_stream_reader *)malloc(sizeof(file_stream_reader));
-	reader->file = file;
-	_fill(reader);
+	reader->fd = fd;
+	reader->buffer_pos = 0;
+	reader->eof = 0;
+	reader->mapped = map_file(fd, &reader->buffer, &reader->buffer_size);
+	reader->buffer_alloc = reader->buffer_size;
+	if (!reader->mapped) {
+		posix_memalign((void **)&reader->buffer, BUFFER_ALIGNMENT, BUFFER_SIZE);
+		reader->buffer_alloc = BUFFER_SIZE;
+		reader->buffer_size = 0;
+		_fill(reader);
+	}
 	return reader;
 }
 
-char peek_byte(file_stream_reader *reader) {
-	if (reader->buffer_pos + 1 > reader->buffer_size) {
-		_fill(reader);
+// Maps a regular file read at offset zero. Anything else (pipes, terminals,
+// a stdin that was partly consumed) is left to the read path, and so is a
+// file that reports no size: /proc and sysfs files do, yet have content.
+char map_file(int fd, char **map, size_t *len) {
+	struct stat st;
+	*map = NULL;
+	*len = 0;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || lseek(fd, 0, SEEK_CUR) != 0 || st.st_size == 0) {
+		return 0;
 	}
-	if (reader->buffer_size == 0) {
-	   	// If an error occurs or the end of the file is reached,
-	   	// return EOF. This signals that the reading process should stop.
-		return EOF;
+	void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (addr == MAP_FAILED) {
+		return 0;
 	}
-	return reader->buffer[reader->buffer_pos];
+	madvise(addr, st.st_size, MADV_SEQUENTIAL);
+	*map = (char *)addr;
+	*len = st.st_size;
+	return 1;
 }
 
-char next_byte(file_stream_reader *reader) {
-	char byte = peek_byte(reader);
-	reader->buffer_pos++;
-	return byte;
+// Returns the unread complete lines of the buffer as one span, reading
+// more first when the complete lines do not add up to more than min_len
+// bytes; a line that straddles the end of a read buffer is moved to the
+// front (and the buffer grown if the line alone fills it) and handed out
+// with the next span. The span stays valid until the next call, and the
+// last line of the input may lack a newline. Returns NULL at the end of
+// the input.
+char *next_lines(file_stream_reader *reader, size_t *len, size_t min_len) {
+	while (1) {
+		char *start = reader->buffer + reader->buffer_pos;
+		size_t available = reader->buffer_size - reader->buffer_pos;
+		if (reader->mapped || reader->eof) {
+			if (available == 0) {
+				return NULL;
+			}
+			*len = available;
+			reader->buffer_pos = reader->buffer_size;
+			return start;
+		}
+		size_t end = available;
+		while (end > min_len && *(start + end - 1) != '\n') {
+			end--;
+		}
+		if (end > min_len) {
+			*len = end;
+			reader->buffer_pos += end;
+			return start;
+		}
+		_fill(reader);
+	}
 }
 
+// Moves the unread bytes to the front of the buffer and reads more after
+// them, growing the buffer when the unread bytes already fill it.
 void _fill(file_stream_reader *reader) {
-	reader->buffer_size = fread(reader->buffer, sizeof(char), BUFFER_SIZE, reader->file);
+	if (reader->mapped) {
+		// The whole file is already in memory.
+		return;
+	}
+	size_t unread = reader->buffer_size - reader->buffer_pos;
+	if (unread == reader->buffer_alloc) {
+		char *grown = NULL;
+		posix_memalign((void **)&grown, BUFFER_ALIGNMENT, reader->buffer_alloc * 2);
+		memcpy(grown, reader->buffer + reader->buffer_pos, unread);
+		free(reader->buffer);
+		reader->buffer = grown;
+		reader->buffer_alloc *= 2;
+	} else {
+		memmove(reader->buffer, reader->buffer + reader->buffer_pos, unread);
+	}
 	reader->buffer_pos = 0;
+	reader->buffer_size = unread;
+	ssize_t len;
+	do {
+		len = read(reader->fd, reader->buffer + unread, reader->buffer_alloc - unread);
+	} while (len < 0 && errno == EINTR);
+	if (len <= 0) {
+		reader->eof = 1;
+		return;
+	}
+	reader->buffer_size += len;
+}
+
+void destroy_file_stream_reader(file_stream_reader *reader) {
+	if (reader->mapped) {
+		if (reader->buffer != NULL) {
+			munmap(reader->buffer, reader->buffer_size);
+		}
+	} else {
+		free(reader->buffer);
+	}
+	if (reader->fd != STDIN_FILENO) {
+		close(reader->fd);
+	}
+	free(reader);
+}
+
+file_stream_writer *create_file_stream_writer(int fd) {
+	file_stream_writer *writer = (file_stream_writer *)malloc(sizeof(file_stream_writer));
+	writer->fd = fd;
+	writer->len = 0;
+	writer->alloc = WRITE_BUFFER_SIZE;
+	writer->buffer = (char *)malloc(WRITE_BUFFER_SIZE);
+	writer->source = NULL;
+	writer->source_len = 0;
+	writer->vectors = fd >= 0 ? (struct iovec *)malloc(MAX_VECTORS * sizeof(struct iovec)) : NULL;
+	writer->vector_count = 0;
+	writer->segment = 0;
+	writer->pipe = 0;
+#ifdef __linux__
+	struct stat st;
+	writer->pipe = fd >= 0 && fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+#endif
+	return writer;
+}
+
+void write_bytes(file_stream_writer *writer, const char *bytes, size_t len) {
+	if (len >= ZERO_COPY_MIN && writer->source != NULL && bytes >= writer->source && bytes + len <= writer->source + writer->source_len) {
+		queue_slice(writer, bytes, len);
+		return;
+	}
+	if (writer->fd < 0) {
+		reserve_output(writer, len);
+	} else if (writer->len + len > WRITE_BUFFER_SIZE) {
+		flush_writer(writer);
+		if (len > WRITE_BUFFER_SIZE) {
+			// Too big to be worth copying: write it straight through.
+			struct iovec vector = { (void *)bytes, len };
+			write_vectors(writer->fd, &vector, 1);
+			return;
+		}
+	}
+	memcpy(writer->buffer + writer->len, bytes, len);
+	writer->len += len;
+}
+
+void write_byte(file_stream_writer *writer, char byte) {
+	if (writer->fd < 0) {
+		reserve_output(writer, 1);
+	} else if (writer->len == WRITE_BUFFER_SIZE) {
+		flush_writer(writer);
+	}
+	*(writer->buffer + writer->len++) = byte;
+}
+
+// Makes room for len more bytes in a writer without a descriptor.
+void reserve_output(file_stream_writer *writer, size_t len) {
+	if (writer->len + len <= writer->alloc) {
+		return;
+	}
+	while (writer->len + len > writer->alloc) {
+		writer->alloc *= 2;
+	}
+	writer->buffer = (char *)realloc(writer->buffer, writer->alloc);
+	if (writer->buffer == NULL) {
+		fprintf(stderr, "cccut: out of memory\n");
+		exit(1);
+	}
+}
+
+// Queues a slice of the source after the bytes buffered so far. This
+// takes up to two vectors, and one more is always left free for the
+// segment flush_writer queues last.
+void queue_slice(file_stream_writer *writer, const char *slice, size_t len) {
+	if (writer->vector_count + 3 > MAX_VECTORS) {
+		flush_writer(writer);
+	}
+	close_segment(writer);
+	(writer->vectors + writer->vector_count)->iov_base = (void *)slice;
+	(writer->vectors + writer->vector_count)->iov_len = len;
+	writer->vector_count++;
+}
+
+// Queues the bytes buffered since the last queued slice.
+void close_segment(file_stream_writer *writer) {
+	if (writer->len > writer->segment) {
+		(writer->vectors + writer->vector_count)->iov_base = writer->buffer + writer->segment;
+		(writer->vectors + writer->vector_count)->iov_len = writer->len - writer->segment;
+		writer->vector_count++;
+	}
+	writer->segment = writer->len;
+}
+
+// The buffer is reused as soon as this returns, so only slices of the
+// source go through vmsplice(2), which lends their pages to the pipe
+// instead of copying them.
+void flush_writer(file_stream_writer *writer) {
+	if (writer->fd < 0) {
+		return;
+	}
+	close_segment(writer);
+	if (!writer->pipe) {
+		write_vectors(writer->fd, writer->vectors, writer->vector_count);
+	} else {
+		for (int i = 0; i < writer->vector_count; i++) {
+			struct iovec *vector = writer->vectors + i;
+			if ((char *)vector->iov_base >= writer->buffer && (char *)vector->iov_base < writer->buffer + writer->alloc) {
+				write_vectors(writer->fd, vector, 1);
+			} else {
+				splice_slice(writer->fd, vector);
+			}
+		}
+	}
+	writer->vector_count = 0;
+	writer->len = 0;
+	writer->segment = 0;
+}
+
+// Calls writev(2), MAX_VECTORS iovecs at a time, until everything is out.
+void write_vectors(int fd, struct iovec *vectors, int count) {
+	while (count > 0) {
+		ssize_t written = writev(fd, vectors, count < MAX_VECTORS ? count : MAX_VECTORS);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written < 0) {
+			fprintf(stderr, "cccut: write error\n");
+			exit(1);
+		}
+		while (count > 0 && (size_t)written >= vectors->iov_len) {
+			written -= vectors->iov_len;
+			vectors++;
+			count--;
+		}
+		if (count > 0) {
+			vectors->iov_base = (char *)vectors->iov_base + written;
+			vectors->iov_len -= written;
+		}
+	}
+}
+
+// Whatever vmsplice(2) does not take (or where it does not exist) is
+// written with writev(2) instead.
+void splice_slice(int fd, struct iovec *slice) {
+#ifdef __linux__
+	while (slice->iov_len > 0) {
+		ssize_t spliced = vmsplice(fd, slice, 1, 0);
+		if (spliced < 0 && errno == EINTR) {
+			continue;
+		}
+		if (spliced < 0) {
+			break;
+		}
+		slice->iov_base = (char *)slice->iov_base + spliced;
+		slice->iov_len -= spliced;
+	}
+#endif
+	write_vectors(fd, slice, slice->iov_len > 0);
+}
+
+void destroy_file_stream_writer(file_stream_writer *writer) {
+	flush_writer(writer);
+	free(writer->vectors);
+	free(writer->buffer);
+	free(writer);
+}
+
+arg_stream *create_arg_stream(unsigned int argc, char **argv) {
+	arg_stream *stream = (arg_stream *)malloc(sizeof(arg_stream));
+	stream->i = 1;
+	stream->arg = *(argv + 1);
+	stream->argc = argc;
+	stream->argv = argv;
+	return stream;
+}
+
+char *peek_arg(arg_stream *stream) {
+	return stream->arg;
+}
+
+char *next_arg(arg_stream *stream) {
+	if (stream->i >= stream->argc) {
+		return NULL;
+	}
+	char *arg = peek_arg(stream);
+	stream->i++;
+	stream->arg = *(stream->argv + stream->i);
+	return arg;
+}
+
+int str_len(char *str) {
+	int len = 0;
+	while (*(str + len) != '\0') {
+		len++;
+	}
+	return len;
+}
+
+int str_compare(char *str1, char *str2) {
+	int len1 = str_len(str1);
+	int len2 = str_len(str2);
+	if (len1 != len2) {
+		return 0;
+	}
+	for (int i = 0; i < len1; i++) {
+		if (*(str1 + i) != *(str2 + i)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+char starts_with(char *str, char *prefix) {
+	while (*prefix != '\0') {
+		if (*str++ != *prefix++) {
+			return 0;
+		}
+	}
+	return 1;
 }
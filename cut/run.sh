@@ -1,3 +1,3 @@
 mkdir -p bin
-clang main.c -o bin/cut
+clang -O2 main.c -o bin/cut -pthread
 ./bin/cut "$@"
@@ -0,0 +1,27 @@
+# Generates the number-heavy corpora (once) and measures the parser on
+# them against a build that converts numbers with strtod/strtoll. Both
+# builds must print the same documents back. Results are printed as JSON;
+# pick sizes with SIZES, e.g.
+#   SIZES="1M 256M" ./bench.sh > results.json
+mkdir -p bin corpus
+clang -O2 main.c -o bin/json_parser -pthread
+clang -O2 -DSTRTOD_NUMBERS main.c -o bin/json_parser_strtod -pthread
+clang -O2 bench/main.c -o bin/bench
+files=""
+for kind in telemetry floats integers; do
+    for size in ${SIZES:-1M 64M}; do
+        file="corpus/$kind-$size"
+        if [ ! -f "$file" ]; then
+            ./bin/bench gen "$kind" "$size" "$file"
+        fi
+        ./bin/json_parser --parse "$file" > bin/parsed
+        ./bin/json_parser_strtod --parse "$file" > bin/parsed_strtod
+        if ! cmp -s bin/parsed bin/parsed_strtod; then
+            echo "ccjsonparser-bench error: number conversion differs from strtod on '$file'." >&2
+            exit 1
+        fi
+        files="$files $file"
+    done
+done
+./bin/bench run ./bin/json_parser $files
+./bin/bench run ./bin/json_parser_strtod $files
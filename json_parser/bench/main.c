@@ -0,0 +1,420 @@
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAS_TSC
+#endif
+
+#define WRITE_BUFFER_SIZE (1 << 20)
+#define RECORD_SIZE 512
+#define RUNS 3
+#define SEED 0x9E3779B97F4A7C15ULL
+
+typedef enum corpus_kind {
+    TELEMETRY_CORPUS,
+    FLOATS_CORPUS,
+    INTEGERS_CORPUS,
+    BAD_CORPUS,
+} corpus_kind;
+
+// Deterministic xorshift64* generator, so a corpus of a given kind and
+// size is byte-for-byte the same on every machine.
+typedef struct rng {
+    uint64_t state;
+} rng;
+
+typedef struct corpus_writer {
+    FILE *file;
+    char *buffer;
+    size_t len;
+    uint64_t written;
+} corpus_writer;
+
+typedef struct measurement {
+    double seconds;
+    uint64_t cycles;
+    char cycles_source[8];
+    long peak_rss_kb;
+    char ok;
+} measurement;
+
+uint64_t next_random(rng *);
+uint64_t random_below(rng *, uint64_t);
+double random_double(rng *, int, int);
+
+corpus_kind read_corpus_kind(char *);
+uint64_t read_size(char *);
+void generate(corpus_kind, uint64_t, char *);
+void write_bytes(corpus_writer *, const char *, size_t);
+int write_telemetry(char *, rng *, uint64_t);
+int write_floats(char *, rng *);
+int write_integers(char *, rng *);
+
+void run(char *, int, char **);
+measurement measure(char *, char *, char *);
+char start_cycle_counter(int *, pid_t);
+double now();
+
+int str_len(char *);
+int str_compare(char *, char *);
+
+const char *corpus_names[] = { "telemetry", "floats", "integers" };
+const char *modes[] = { NULL, "--parse" };
+const char *mode_names[] = { "validate", "parse" };
+
+const char *units[] = { "celsius", "kelvin", "pascal", "volt", "ampere", "hertz" };
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "ccjsonparser-bench error: missing command, expected 'gen' or 'run'.\n");
+        exit(1);
+    }
+    char *command = *(argv + 1);
+    if (str_compare(command, "gen")) {
+        if (argc != 5) {
+            fprintf(stderr, "ccjsonparser-bench error: expected 'gen <kind> <size> <path>'.\n");
+            exit(1);
+        }
+        corpus_kind kind = read_corpus_kind(*(argv + 2));
+        if (kind == BAD_CORPUS) {
+            fprintf(stderr, "ccjsonparser-bench error: invalid corpus kind '%s'.\n", *(argv + 2));
+            exit(1);
+        }
+        uint64_t size = read_size(*(argv + 3));
+        if (size == 0) {
+            fprintf(stderr, "ccjsonparser-bench error: invalid size '%s'.\n", *(argv + 3));
+            exit(1);
+        }
+        generate(kind, size, *(argv + 4));
+    } else if (str_compare(command, "run")) {
+        if (argc < 4) {
+            fprintf(stderr, "ccjsonparser-bench error: expected 'run <json_parser> <file>...'.\n");
+            exit(1);
+        }
+        run(*(argv + 2), argc - 3, argv + 3);
+    } else {
+        fprintf(stderr, "ccjsonparser-bench error: invalid command '%s', expected 'gen' or 'run'.\n", command);
+        exit(1);
+    }
+    return 0;
+}
+
+uint64_t next_random(rng *rng) {
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return rng->state * 0x2545F4914F6CDD1DULL;
+}
+
+uint64_t random_below(rng *rng, uint64_t n) {
+    return next_random(rng) % n;
+}
+
+// A uniformly random mantissa scaled by a random power of ten in
+// [min_exponent, max_exponent].
+double random_double(rng *rng, int min_exponent, int max_exponent) {
+    double value = (double)(next_random(rng) >> 11) / (double)(1ULL << 53);
+    int exponent = min_exponent + (int)random_below(rng, max_exponent - min_exponent + 1);
+    for (; exponent > 0; exponent--) {
+        value *= 10;
+    }
+    for (; exponent < 0; exponent++) {
+        value /= 10;
+    }
+    return next_random(rng) & 1 ? -value : value;
+}
+
+corpus_kind read_corpus_kind(char *name) {
+    for (int i = 0; i < BAD_CORPUS; i++) {
+        if (str_compare(name, (char *)*(corpus_names + i))) {
+            return (corpus_kind)i;
+        }
+    }
+    return BAD_CORPUS;
+}
+
+// Sizes are plain byte counts with an optional K, M or G suffix (powers
+// of 1024). Returns 0 for anything malformed.
+uint64_t read_size(char *arg) {
+    uint64_t size = 0;
+    char *c = arg;
+    for (; *c >= '0' && *c <= '9'; c++) {
+        size = size * 10 + (*c - '0');
+    }
+    if (*c == 'K' || *c == 'k') {
+        size <<= 10;
+        c++;
+    } else if (*c == 'M' || *c == 'm') {
+        size <<= 20;
+        c++;
+    } else if (*c == 'G' || *c == 'g') {
+        size <<= 30;
+        c++;
+    }
+    return c == arg || *c != '\0' ? 0 : size;
+}
+
+// Writes one array of records, stopping at the first record that reaches
+// the target size so the document stays valid.
+void generate(corpus_kind kind, uint64_t size, char *path) {
+    corpus_writer writer;
+    writer.file = fopen(path, "wb");
+    if (writer.file == NULL) {
+        fprintf(stderr, "ccjsonparser-bench error: cannot create '%s'.\n", path);
+        exit(1);
+    }
+    writer.buffer = (char *)malloc(WRITE_BUFFER_SIZE);
+    writer.len = 0;
+    writer.written = 0;
+    rng rng = { SEED + kind };
+    char record[RECORD_SIZE];
+    write_bytes(&writer, "[\n", 2);
+    for (uint64_t i = 0; writer.written < size; i++) {
+        if (i > 0) {
+            write_bytes(&writer, ",\n", 2);
+        }
+        int len;
+        switch (kind) {
+            case TELEMETRY_CORPUS:
+                len = write_telemetry(record, &rng, i);
+                break;
+            case FLOATS_CORPUS:
+                len = write_floats(record, &rng);
+                break;
+            default:
+                len = write_integers(record, &rng);
+                break;
+        }
+        write_bytes(&writer, record, len);
+    }
+    write_bytes(&writer, "\n]\n", 3);
+    fwrite(writer.buffer, sizeof(char), writer.len, writer.file);
+    fclose(writer.file);
+    free(writer.buffer);
+}
+
+void write_bytes(corpus_writer *writer, const char *bytes, size_t len) {
+    if (writer->len + len > WRITE_BUFFER_SIZE) {
+        fwrite(writer->buffer, sizeof(char), writer->len, writer->file);
+        writer->len = 0;
+    }
+    memcpy(writer->buffer + writer->len, bytes, len);
+    writer->len += len;
+    writer->written += len;
+}
+
+// A sensor reading as a device would report it: a millisecond timestamp,
+// short fixed-point measurements and coordinates with six decimals.
+int write_telemetry(char *record, rng *rng, uint64_t i) {
+    int len = snprintf(record, RECORD_SIZE,
+                       "{\"ts\":%" PRIu64 ",\"sensor\":\"s-%03d\",\"unit\":\"%s\",\"value\":%.3f,\"battery\":%.2f,"
+                       "\"lat\":%.6f,\"lon\":%.6f,\"samples\":[",
+                       (uint64_t)1700000000000ULL + i * 250 + random_below(rng, 250), (int)random_below(rng, 1000),
+                       *(units + random_below(rng, sizeof(units) / sizeof(*units))), random_double(rng, 1, 3),
+                       (double)random_below(rng, 10001) / 100, random_double(rng, 1, 1) * 9,
+                       random_double(rng, 2, 2) * 1.8);
+    int count = 4 + random_below(rng, 5);
+    for (int j = 0; j < count; j++) {
+        len += snprintf(record + len, RECORD_SIZE - len, "%s%.4f", j == 0 ? "" : ",", random_double(rng, -2, 2));
+    }
+    len += snprintf(record + len, RECORD_SIZE - len, "]}");
+    return len;
+}
+
+// Doubles printed to round-trip, over the whole exponent range.
+int write_floats(char *record, rng *rng) {
+    int len = 0;
+    for (int j = 0; j < 8; j++) {
+        len += snprintf(record + len, RECORD_SIZE - len, "%s%.17g", j == 0 ? "[" : ",", random_double(rng, -300, 300));
+    }
+    len += snprintf(record + len, RECORD_SIZE - len, "]");
+    return len;
+}
+
+// Integers of every length up to the full int64 range.
+int write_integers(char *record, rng *rng) {
+    int len = 0;
+    for (int j = 0; j < 8; j++) {
+        int64_t value = (int64_t)(next_random(rng) >> random_below(rng, 64));
+        len += snprintf(record + len, RECORD_SIZE - len, "%s%" PRId64, j == 0 ? "[" : ",", value);
+    }
+    len += snprintf(record + len, RECORD_SIZE - len, "]");
+    return len;
+}
+
+// Runs every mode over every file, keeps the fastest of RUNS runs and
+// prints one JSON object per measurement.
+void run(char *parser_path, int files_count, char **files) {
+    printf("[\n");
+    char first = 1;
+    for (int i = 0; i < files_count; i++) {
+        char *file = *(files + i);
+        struct stat st;
+        if (stat(file, &st) != 0) {
+            fprintf(stderr, "ccjsonparser-bench error: file '%s' does not exist.\n", file);
+            exit(1);
+        }
+        for (int j = 0; j < 2; j++) {
+            measurement best;
+            best.ok = 0;
+            for (int k = 0; k < RUNS; k++) {
+                measurement m = measure(parser_path, (char *)*(modes + j), file);
+                if (!m.ok) {
+                    fprintf(stderr, "ccjsonparser-bench error: '%s' failed on '%s'.\n", parser_path, file);
+                    exit(1);
+                }
+                if (!best.ok || m.seconds < best.seconds) {
+                    long peak_rss_kb = best.ok && best.peak_rss_kb > m.peak_rss_kb ? best.peak_rss_kb : m.peak_rss_kb;
+                    best = m;
+                    best.peak_rss_kb = peak_rss_kb;
+                }
+            }
+            double bytes = st.st_size;
+            printf("%s  {\"parser\": \"%s\", \"file\": \"%s\", \"bytes\": %" PRIu64 ", \"mode\": \"%s\", \"seconds\": %.6f, \"gb_per_s\": %.3f, ",
+                   first ? "" : ",\n", parser_path, file, (uint64_t)st.st_size, *(mode_names + j), best.seconds,
+                   best.seconds > 0 ? bytes / best.seconds / 1e9 : 0.0);
+            if (*best.cycles_source != '\0' && bytes > 0) {
+                printf("\"cycles_per_byte\": %.3f, \"cycles_source\": \"%s\", ", best.cycles / bytes, best.cycles_source);
+            } else {
+                printf("\"cycles_per_byte\": null, \"cycles_source\": null, ");
+            }
+            printf("\"peak_rss_kb\": %ld}", best.peak_rss_kb);
+            fflush(stdout);
+            first = 0;
+        }
+    }
+    printf("\n]\n");
+}
+
+// Runs the parser once with -q, so printing is not part of the measure.
+// The child waits on a pipe until the cycle counter is attached, so only
+// the parser itself is measured.
+measurement measure(char *parser_path, char *mode, char *file) {
+    measurement m;
+    memset(&m, 0, sizeof(m));
+    int go[2];
+    if (pipe(go) != 0) {
+        return m;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        char byte;
+        close(*(go + 1));
+        if (read(*go, &byte, 1) < 0) {
+            _exit(127);
+        }
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        if (mode != NULL) {
+            execl(parser_path, parser_path, "-q", mode, file, (char *)NULL);
+        } else {
+            execl(parser_path, parser_path, "-q", file, (char *)NULL);
+        }
+        _exit(127);
+    }
+    close(*go);
+    int perf_fd = -1;
+    char has_perf = start_cycle_counter(&perf_fd, pid);
+#ifdef HAS_TSC
+    uint64_t tsc_start = __rdtsc();
+#endif
+    double start = now();
+    if (write(*(go + 1), "g", 1) < 0) {
+        close(*(go + 1));
+        return m;
+    }
+    close(*(go + 1));
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        return m;
+    }
+    m.seconds = now() - start;
+#ifdef HAS_TSC
+    uint64_t tsc_cycles = __rdtsc() - tsc_start;
+#endif
+    m.peak_rss_kb = usage.ru_maxrss;
+    m.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    if (has_perf && read(perf_fd, &m.cycles, sizeof(m.cycles)) == sizeof(m.cycles)) {
+        strcpy(m.cycles_source, "perf");
+    }
+#ifdef HAS_TSC
+    else {
+        m.cycles = tsc_cycles;
+        strcpy(m.cycles_source, "tsc");
+    }
+#endif
+    if (perf_fd >= 0) {
+        close(perf_fd);
+    }
+    return m;
+}
+
+// Counts the child's CPU cycles (and its threads') from exec onwards.
+// Kernels that forbid perf events leave us with the time stamp counter.
+char start_cycle_counter(int *perf_fd, pid_t pid) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.disabled = 1;
+    attr.enable_on_exec = 1;
+    attr.inherit = 1;
+    attr.exclude_hv = 1;
+    *perf_fd = syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+    if (*perf_fd < 0) {
+        attr.exclude_kernel = 1;
+        *perf_fd = syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+    }
+    return *perf_fd >= 0;
+#else
+    (void)pid;
+    *perf_fd = -1;
+    return 0;
+#endif
+}
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int str_len(char *str) {
+    int len = 0;
+    while (*(str + len) != '\0') {
+        len++;
+    }
+    return len;
+}
+
+int str_compare(char *str1, char *str2) {
+    int len1 = str_len(str1);
+    int len2 = str_len(str2);
+    if (len1 != len2) {
+        return 0;
+    }
+    for (int i = 0; i < len1; i++) {
+        if (*(str1 + i) != *(str2 + i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,89 @@
+#ifndef JSON_PARSER_H
+#define JSON_PARSER_H
+
+// The validator as a library. Build main.c without the command line
+// tool and link the object:
+//   clang -O2 -c -DJSON_PARSER_LIBRARY main.c -o json_parser.o
+//
+// Events point into the caller's buffer, which must outlive the parser;
+// nothing is copied, and escapes are only decoded by json_decode_string.
+// A parser allocates once when it is created: a fixed window of the
+// structural index and a depth stack that grows up to max_depth.
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum json_event_type {
+    JSON_START_OBJECT,
+    JSON_END_OBJECT,
+    JSON_START_ARRAY,
+    JSON_END_ARRAY,
+    JSON_KEY,
+    JSON_STRING,
+    JSON_NUMBER,
+    JSON_TRUE,
+    JSON_FALSE,
+    JSON_NULL,
+    // The document ended and nothing follows it.
+    JSON_DONE,
+    // The input is not valid JSON; raw points where that was found.
+    JSON_ERROR,
+} json_event_type;
+
+// raw and len are the event's bytes in the input: a number or literal as
+// written, the contents of a key or string without its quotes (escapes
+// still in), or the bracket of a start or end.
+typedef struct json_event {
+    json_event_type type;
+    const char *raw;
+    size_t len;
+} json_event;
+
+typedef struct json_parser json_parser;
+
+// Called for every event up to JSON_DONE or JSON_ERROR; returning 0 stops
+// the parse.
+typedef int (*json_handler)(const json_event *, void *);
+
+// Pull interface: each call to json_parser_next returns the next event.
+// Once JSON_DONE or JSON_ERROR is returned, every later call returns it
+// again. Any value is accepted as the document, nested at most max_depth
+// containers deep.
+json_parser *json_parser_create(const char *, size_t, size_t);
+json_event json_parser_next(json_parser *);
+void json_parser_destroy(json_parser *);
+
+// Push interface over the same parser. Returns 1 for a valid document, 0
+// for an invalid one and -1 if the handler stopped it.
+int json_parse(const char *, size_t, size_t, json_handler, void *);
+
+// Decodes the escapes of a JSON_KEY or JSON_STRING into out, which needs
+// room for len bytes, and returns the decoded length.
+size_t json_decode_string(const json_event *, char *);
+
+// Converts a JSON_NUMBER exactly. Returns 1 and sets *integer when it is
+// an integer that fits int64, otherwise returns 0 and sets *real.
+int json_number(const json_event *, int64_t *, double *);
+
+typedef enum json_status {
+    // Valid so far, but more input is needed.
+    JSON_INCOMPLETE,
+    // A whole document has been read; only whitespace may follow it.
+    JSON_COMPLETE,
+    JSON_INVALID,
+} json_status;
+
+typedef struct json_feeder json_feeder;
+
+// Incremental interface: checks a document handed over in pieces of any
+// size, as they arrive, without keeping them. Between two pieces only the
+// grammar state, the depth stack and the progress through a split token
+// are kept. Each json_feed reports the status as soon as it is known, and
+// an invalid document stays invalid; json_feed_end marks the end of the
+// input.
+json_feeder *json_feeder_create(size_t);
+json_status json_feed(json_feeder *, const char *, size_t);
+json_status json_feed_end(json_feeder *);
+void json_feeder_destroy(json_feeder *);
+
+#endif
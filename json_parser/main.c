@@ -1,8 +1,50 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-#define MAX_DEPTH 20
+#include "json_parser.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAS_X86_KERNELS
+#endif
+
+// The library build exports only the json_* functions of json_parser.h;
+// everything else stays inside this file. The command line code is still
+// compiled there, just never called.
+#ifdef JSON_PARSER_LIBRARY
+#define INTERNAL static __attribute__((unused))
+#else
+#define INTERNAL
+#endif
+
+// The nesting JSON_checker allows; --max-depth raises it.
+#define DEFAULT_MAX_DEPTH 19
+#define MAX_DEPTH_LIMIT 1000000000
+#define DEPTH_STACK_SIZE 64
+#define UTF8_ACCEPT 0
+#define UTF8_REJECT 12
+#define INDEX_CAPACITY 16384
+#define READ_BUFFER_SIZE (1 << 20)
+#define BUFFER_ALIGNMENT 64
 #define FILE_OPTION (1 << 0);
+#define PARSE_OPTION (1 << 1)
+#define NDJSON_OPTION (1 << 2)
+#define QUIET_OPTION (1 << 3)
+#define SELECT_OPTION (1 << 4)
+#define STREAM_OPTION (1 << 5)
+#define MAX_JOBS 256
+#define MIN_CHUNK_SIZE (1 << 20)
+#define NUMBER_BUFFER_SIZE 64
 
 typedef enum token_type {
     LEFT_BRACKET_TOKEN,
@@ -19,120 +61,750 @@ typedef enum token_type {
     BAD_TOKEN,
 } token_type;
 
+// Only option parsing still uses these.
 typedef struct string {
     char *buffer;
     int len;
     int alloc;
 } string;
 
+// A token is a slice of the input: offset and len locate its bytes.
 typedef struct token {
     token_type type;
+    size_t offset;
+    size_t len;
 } token;
 
+// The whole document as one contiguous span: a mapping for regular files,
+// an aligned heap buffer filled by large reads for pipes and stdin.
 typedef struct char_stream {
-    FILE *file;
-    char curr;
+    char *data;
+    size_t len;
+    char mapped;
+    int fd;
 } char_stream;
 
+// What stage 1 needs to know about the 64 bytes of one block, one bit
+// per byte.
+typedef struct block_masks {
+    uint64_t backslash;
+    uint64_t quote;
+    uint64_t whitespace;
+    uint64_t structural;
+    uint64_t control;
+} block_masks;
+
+typedef void (*block_kernel)(const char *, block_masks *);
+
+// Checks one block of UTF-8 and returns the positions of the bytes where it
+// goes wrong. The carry is whatever the kernel needs from the block before.
+typedef uint64_t (*utf8_kernel)(const char *, uint32_t *);
+
+// Stage 1 output: the offsets of every token in the input, found 64 bytes
+// at a time without looking at the grammar, plus the closing quote of each
+// string. It is filled a window of offsets at a time; the carries let a
+// window pick up mid-string. bad_char is the first byte that makes the
+// document invalid wherever it is: malformed UTF-8 or a control character
+// inside a string. It is SIZE_MAX until one is found.
+typedef struct structural_index {
+    size_t *offsets;
+    size_t count;
+    size_t next;
+    size_t indexed;
+    size_t bad_char;
+    uint64_t in_string;
+    uint64_t escaped;
+    uint64_t scalar;
+    uint32_t utf8_carry;
+    block_kernel classify;
+    utf8_kernel validate_utf8;
+} structural_index;
+
 typedef struct token_stream {
     char_stream *char_stream;
+    structural_index index;
     token curr;
 } token_stream;
 
-char is_whitespace(char);
-char is_numeric(char);
-char is_valid_escaping_char(char);
-char is_hex(char);
-
-int read_options(int, char **);
-char is_option(string *);
-
-string *create_str(char *);
-void destroy_str(string *);
-void push_c(string *, char);
-char compare_str(string *, string *);
-
-char_stream create_char_stream(char *);
-char next_char(token_stream *);
-char peek_char(token_stream *);
-char is_char_stream_end(char_stream *);
-void destroy_char_stream(char_stream *);
-
-token get_token(token_stream *);
-token_stream create_token_stream(char_stream *);
-token next_token(token_stream *);
-token peek_token(token_stream *);
+// Where the grammar is between two tokens. Inside a container, a value is
+// followed by ARRAY_NEXT_STATE or OBJECT_NEXT_STATE; that is what the
+// depth stack holds for each open container.
+typedef enum grammar_state {
+    START_STATE,
+    VALUE_STATE,
+    ARRAY_FIRST_STATE,
+    ARRAY_NEXT_STATE,
+    OBJECT_FIRST_STATE,
+    OBJECT_KEY_STATE,
+    OBJECT_COLON_STATE,
+    OBJECT_NEXT_STATE,
+    GRAMMAR_STATE_COUNT,
+} grammar_state;
+
+// What a token does in a state. REJECT_MOVE is zero so that every pair the
+// table leaves out is an error.
+typedef enum grammar_move {
+    REJECT_MOVE,
+    SCALAR_MOVE,
+    OPEN_ARRAY_MOVE,
+    OPEN_OBJECT_MOVE,
+    CLOSE_MOVE,
+    KEY_MOVE,
+    COLON_MOVE,
+    ARRAY_COMMA_MOVE,
+    OBJECT_COMMA_MOVE,
+} grammar_move;
+
+// The open containers, as the state to resume once each one's current
+// value is done. It lives on the heap and grows up to max entries.
+typedef struct depth_stack {
+    uint8_t *states;
+    size_t len;
+    size_t alloc;
+    size_t max;
+} depth_stack;
+
+// A parsed document: one flat tape of 64-bit words in a single arena that
+// doubles as it fills. Each word has a tag in its low byte and a payload
+// above it:
+// - '[' and '{': the index just past the matching close, so a subtree is
+//   skipped in one step. While the container is open, the index of the
+//   container around it instead.
+// - ']' and '}': the index of the matching open.
+// - '"' and 'k' (an object key): the decoded length; the bytes follow,
+//   NUL-terminated, padded to whole words.
+// - 'l' and 'd': no payload; the next word is the int64 or double.
+// - 't', 'f' and 'n': no payload.
+// Words refer to each other by index only, so the arena may move as it
+// grows, and one free releases the whole document.
+typedef struct dom {
+    uint64_t *words;
+    size_t len;
+    size_t alloc;
+    size_t open;
+} dom;
+
+// A byte range of an NDJSON input, whole lines only, checked on its own
+// thread. Lines are numbered from 1 within the chunk; the caller adds the
+// lines of the chunks before it.
+typedef struct ndjson_chunk {
+    const char *span;
+    size_t len;
+    int max_depth;
+    size_t lines;
+    size_t *failures;
+    size_t failures_count;
+    size_t failures_alloc;
+} ndjson_chunk;
+
+// One step of a --select path: an object key or an array index, or "*"
+// for every member or element. index is SIZE_MAX for a name that is not
+// a valid array index.
+typedef struct path_segment {
+    char *name;
+    size_t len;
+    size_t index;
+    char wildcard;
+} path_segment;
+
+// A --select path split into segments, with their names decoded into one
+// buffer. Keys that contain escapes are decoded into key_buffer before
+// they are compared.
+typedef struct selector {
+    path_segment *segments;
+    size_t count;
+    char *names;
+    char *key_buffer;
+    size_t key_alloc;
+    depth_stack *stack;
+} selector;
+
+// How far a pull parser is: still inside the document, or past its end
+// with every later call returning JSON_DONE or JSON_ERROR.
+typedef enum parser_progress {
+    PARSING_PROGRESS,
+    DONE_PROGRESS,
+    FAILED_PROGRESS,
+} parser_progress;
+
+// A pull parser over the caller's buffer: the grammar state between two
+// events, and its progress.
+struct json_parser {
+    char_stream char_stream;
+    token_stream token_stream;
+    depth_stack stack;
+    uint8_t state;
+    uint8_t progress;
+};
+
+// Where the feeder is between two bytes: between tokens, or how far into
+// a string, number or keyword.
+typedef enum lexer_state {
+    BETWEEN_LEX,
+    STRING_LEX,
+    ESCAPE_LEX,
+    HEX_LEX,
+    MINUS_LEX,
+    ZERO_LEX,
+    INTEGER_LEX,
+    DOT_LEX,
+    FRACTION_LEX,
+    EXPONENT_MARK_LEX,
+    EXPONENT_SIGN_LEX,
+    EXPONENT_LEX,
+    KEYWORD_LEX,
+} lexer_state;
+
+// An incremental validator. The grammar moves when a token starts, so an
+// error is found at the first byte that makes one; the token itself is
+// then checked byte by byte, in as many pieces as it comes in. finished is
+// set once the root value has started and closed.
+struct json_feeder {
+    depth_stack stack;
+    uint8_t state;
+    uint8_t lexer;
+    uint8_t hex_left;
+    uint32_t utf8;
+    const char *keyword;
+    char finished;
+    char failed;
+};
+
+typedef struct settings {
+    int options;
+    int max_depth;
+    int jobs;
+    int files_start;
+    int chunk_size;
+    char *select_path;
+} settings;
+
+INTERNAL char is_whitespace(char);
+INTERNAL char is_structural(char);
+INTERNAL char is_numeric(char);
+INTERNAL char is_valid_escaping_char(char);
+INTERNAL char is_hex(char);
+INTERNAL char is_alpha(char);
+
+INTERNAL void read_options(int, char **, settings *);
+INTERNAL char *read_value(int, char **, int *);
+INTERNAL int read_number(char *, int);
+INTERNAL char is_valid_path(char *);
+INTERNAL char is_option(string *);
+
+INTERNAL string *create_str(char *);
+INTERNAL void destroy_str(string *);
+INTERNAL char compare_str(string *, string *);
+
+INTERNAL char_stream create_char_stream(char *);
+INTERNAL char map_file(int, char **, size_t *);
+INTERNAL void read_all(char_stream *);
+INTERNAL void destroy_char_stream(char_stream *);
+
+INTERNAL token get_token(token_stream *);
+INTERNAL char check_escapes(const char *, size_t, size_t);
+INTERNAL size_t scan_number(const char *, size_t, size_t);
+INTERNAL size_t skip_digits(const char *, size_t, size_t);
+INTERNAL token_type match_keyword(const char *, size_t, size_t, size_t *);
+INTERNAL token_stream create_token_stream(char_stream *);
+INTERNAL void reset_token_stream(token_stream *, char_stream *);
+INTERNAL token next_token(token_stream *);
+INTERNAL token peek_token(token_stream *);
 char is_token_stream_end(token_stream *);
-void destroy_token_stream(token_stream *);
-void print_token(token *);
+INTERNAL void destroy_token_stream(token_stream *);
+INTERNAL void print_token(token *);
+
+INTERNAL void init_structural_index(structural_index *);
+INTERNAL void reset_structural_index(structural_index *);
+INTERNAL void fill_index(structural_index *, char_stream *);
+INTERNAL uint64_t find_structurals(structural_index *, block_masks *, uint64_t *);
+INTERNAL uint64_t find_escaped(uint64_t, uint64_t *);
+INTERNAL uint64_t prefix_xor(uint64_t);
+INTERNAL block_kernel select_block_kernel();
+INTERNAL utf8_kernel select_utf8_kernel();
+INTERNAL void classify_block_scalar(const char *, block_masks *);
+INTERNAL uint64_t validate_utf8_scalar(const char *, uint32_t *);
+#ifdef HAS_X86_KERNELS
+INTERNAL void classify_block_sse2(const char *, block_masks *);
+INTERNAL void classify_block_avx2(const char *, block_masks *);
+INTERNAL uint64_t validate_utf8_avx2(const char *, uint32_t *);
+#endif
 
-int check_initial_expression(token_stream *);
-int check_expression(token_stream *, int);
-int check_array_expression(token_stream *, int);
-int check_object_expression(token_stream *, int);
-int check_object_property(token_stream *, int);
+INTERNAL depth_stack create_depth_stack(size_t);
+INTERNAL char push_depth(depth_stack *, uint8_t);
+INTERNAL void destroy_depth_stack(depth_stack *);
+INTERNAL int check_initial_expression(token_stream *, depth_stack *, dom *);
+INTERNAL int check_document(token_stream *, depth_stack *, dom *, uint8_t);
 
-void check_file(char *);
+INTERNAL dom create_dom(size_t);
+INTERNAL uint64_t *reserve_words(dom *, size_t);
+INTERNAL void append_open(dom *, char);
+INTERNAL void append_close(dom *, char);
+INTERNAL void append_string(dom *, char, const char *, size_t);
+INTERNAL char append_number(dom *, const char *, size_t);
+INTERNAL char parse_number(const char *, size_t, int64_t *, double *);
+INTERNAL const char *parse_digits(const char *, const char *, uint64_t *);
+INTERNAL char is_eight_digits(const char *);
+INTERNAL uint32_t parse_eight_digits(const char *);
+INTERNAL double compute_double(int64_t, uint64_t, char);
+INTERNAL double parse_double_fallback(const char *, size_t);
+INTERNAL char append_value(dom *, const char *, token);
+INTERNAL size_t decode_string(const char *, size_t, char *);
+INTERNAL size_t encode_utf8(uint32_t, char *);
+INTERNAL uint32_t read_hex4(const char *);
+INTERNAL char dom_tag(dom *, size_t);
+INTERNAL size_t dom_next(dom *, size_t);
+INTERNAL const char *dom_string(dom *, size_t, size_t *);
+INTERNAL int64_t dom_int64(dom *, size_t);
+INTERNAL double dom_double(dom *, size_t);
+INTERNAL void destroy_dom(dom *);
+INTERNAL void print_dom(dom *, FILE *);
+INTERNAL void print_json_string(const char *, size_t, FILE *);
 
-string *null_str;
-string *true_str;
-string *false_str;
+INTERNAL void check_file(char *, settings *, depth_stack *);
+INTERNAL void check_ndjson_file(char *, settings *);
+INTERNAL void *check_ndjson_chunk(void *);
+INTERNAL void add_failure(ndjson_chunk *, size_t);
 
+INTERNAL void stream_file(char *, settings *);
+INTERNAL void init_feeder(json_feeder *, size_t, uint8_t);
+INTERNAL char start_token(json_feeder *, char);
+INTERNAL json_status feeder_status(json_feeder *);
+
+INTERNAL void select_file(char *, settings *, depth_stack *);
+INTERNAL selector create_selector(char *, depth_stack *);
+INTERNAL void destroy_selector(selector *);
+INTERNAL int select_value(selector *, token_stream *, size_t);
+INTERNAL int select_matched(selector *, token_stream *, size_t);
+INTERNAL int skip_value(token_stream *, size_t, size_t);
+INTERNAL char match_key(selector *, path_segment *, const char *, token);
+INTERNAL void print_compact(const char *, size_t, size_t, FILE *);
+
+#ifndef JSON_PARSER_LIBRARY
 int main(int argc, char **argv) {
-    null_str = create_str("null");
-    true_str = create_str("true");
-    false_str = create_str("false");
-    int options = read_options(argc, argv);
-    int i = 1;
-    while (i < argc && *(*(argv + i)) == '-') {
-        i++;
-    }
+    settings settings;
+    read_options(argc, argv, &settings);
+    depth_stack stack = create_depth_stack(settings.max_depth);
+    int i = settings.files_start;
     int files_count = argc - i;
     if (files_count == 0) {
-        check_file(NULL);
+        check_file(NULL, &settings, &stack);
     } else {
         char **files = argv + i;
         for (int j = 0; j < files_count; j++) {
-            check_file(*(files + j));
+            check_file(*(files + j), &settings, &stack);
         }
     }
-    destroy_str(null_str);
-    destroy_str(true_str);
-    destroy_str(false_str);
+    destroy_depth_stack(&stack);
     return 0;
 }
+#endif
 
-void check_file(char *file_path) {
+// With --parse, a valid document is built into a DOM and printed back as
+// compact JSON instead of being reported as valid; -q builds it without
+// printing anything, to time the parse alone.
+INTERNAL void check_file(char *file_path, settings *settings, depth_stack *stack) {
+    if (settings->options & NDJSON_OPTION) {
+        check_ndjson_file(file_path, settings);
+        return;
+    }
+    if (settings->options & SELECT_OPTION) {
+        select_file(file_path, settings, stack);
+        return;
+    }
+    if (settings->options & STREAM_OPTION) {
+        stream_file(file_path, settings);
+        return;
+    }
     char_stream char_stream = create_char_stream(file_path);
     token_stream token_stream = create_token_stream(&char_stream);
-    int res = check_initial_expression(&token_stream);
+    dom dom;
+    char parse = (settings->options & PARSE_OPTION) != 0;
+    if (parse) {
+        dom = create_dom(char_stream.len);
+    }
+    int res = check_initial_expression(&token_stream, stack, parse ? &dom : NULL);
     if (peek_token(&token_stream).type != EOF_TOKEN) {
         res = 0;
     }
     char *file_name = file_path == NULL ? "stdin" : file_path;
-    if (res) {
+    if (settings->options & QUIET_OPTION) {
+        // Nothing to report.
+    } else if (res && parse) {
+        print_dom(&dom, stdout);
+    } else if (res) {
+        printf("%s valid\n", file_name);
+    } else {
+        printf("%s invalid\n", file_name);
+    }
+    if (parse) {
+        destroy_dom(&dom);
+    }
+    destroy_token_stream(&token_stream);
+}
+
+// Checks every line as a document of its own and reports each invalid one
+// by line number. A large input is split into one chunk of whole lines per
+// job, and the chunks are checked concurrently; their failures are printed
+// in file order once all are done.
+INTERNAL void check_ndjson_file(char *file_path, settings *settings) {
+    char_stream char_stream = create_char_stream(file_path);
+    int jobs = settings->jobs;
+    if ((size_t)jobs > char_stream.len / MIN_CHUNK_SIZE) {
+        jobs = char_stream.len / MIN_CHUNK_SIZE;
+    }
+    if (jobs < 1) {
+        jobs = 1;
+    }
+    ndjson_chunk *chunks = (ndjson_chunk *)malloc(jobs * sizeof(ndjson_chunk));
+    pthread_t *threads = (pthread_t *)malloc(jobs * sizeof(pthread_t));
+    size_t start = 0;
+    for (int i = 0; i < jobs; i++) {
+        size_t end = char_stream.len;
+        if (i < jobs - 1) {
+            end = char_stream.len / jobs * (i + 1);
+            if (end <= start) {
+                end = start;
+            } else {
+                char *newline = memchr(char_stream.data + end - 1, '\n', char_stream.len - end + 1);
+                end = newline != NULL ? (size_t)(newline - char_stream.data) + 1 : char_stream.len;
+            }
+        }
+        ndjson_chunk *chunk = chunks + i;
+        chunk->span = char_stream.data + start;
+        chunk->len = end - start;
+        chunk->max_depth = settings->max_depth;
+        if (jobs == 1) {
+            check_ndjson_chunk(chunk);
+        } else if (pthread_create(threads + i, NULL, check_ndjson_chunk, chunk) != 0) {
+            fprintf(stderr, "ccjsonparser: could not start a worker thread\n");
+            exit(1);
+        }
+        start = end;
+    }
+    char *file_name = file_path == NULL ? "stdin" : file_path;
+    size_t lines = 0;
+    size_t failures = 0;
+    for (int i = 0; i < jobs; i++) {
+        if (jobs > 1) {
+            pthread_join(*(threads + i), NULL);
+        }
+        ndjson_chunk *chunk = chunks + i;
+        for (size_t j = 0; j < chunk->failures_count; j++) {
+            printf("%s:%zu invalid\n", file_name, lines + *(chunk->failures + j));
+        }
+        lines += chunk->lines;
+        failures += chunk->failures_count;
+        free(chunk->failures);
+    }
+    if (failures == 0) {
         printf("%s valid\n", file_name);
     } else {
         printf("%s invalid\n", file_name);
     }
+    free(threads);
+    free(chunks);
+    destroy_char_stream(&char_stream);
+}
+
+// Each line gets a fresh token stream over its own bytes, but the index
+// and depth stack are reused, so nothing is allocated per line. A line
+// may hold any JSON value; blank lines are skipped.
+INTERNAL void *check_ndjson_chunk(void *arg) {
+    ndjson_chunk *chunk = (ndjson_chunk *)arg;
+    chunk->lines = 0;
+    chunk->failures = NULL;
+    chunk->failures_count = 0;
+    chunk->failures_alloc = 0;
+    depth_stack stack = create_depth_stack(chunk->max_depth);
+    char_stream line;
+    line.mapped = 0;
+    line.fd = -1;
+    token_stream token_stream;
+    init_structural_index(&token_stream.index);
+    size_t pos = 0;
+    while (pos < chunk->len) {
+        const char *newline = memchr(chunk->span + pos, '\n', chunk->len - pos);
+        size_t end = newline != NULL ? (size_t)(newline - chunk->span) : chunk->len;
+        chunk->lines++;
+        line.data = (char *)chunk->span + pos;
+        line.len = end - pos;
+        reset_token_stream(&token_stream, &line);
+        if (peek_token(&token_stream).type != EOF_TOKEN) {
+            int res = check_document(&token_stream, &stack, NULL, VALUE_STATE);
+            if (!res || peek_token(&token_stream).type != EOF_TOKEN) {
+                add_failure(chunk, chunk->lines);
+            }
+        }
+        pos = end + 1;
+    }
+    free(token_stream.index.offsets);
+    destroy_depth_stack(&stack);
+    return NULL;
+}
+
+INTERNAL void add_failure(ndjson_chunk *chunk, size_t line) {
+    if (chunk->failures_count == chunk->failures_alloc) {
+        chunk->failures_alloc = chunk->failures_alloc == 0 ? 64 : chunk->failures_alloc * 2;
+        chunk->failures = (size_t *)realloc(chunk->failures, chunk->failures_alloc * sizeof(size_t));
+    }
+    *(chunk->failures + chunk->failures_count++) = line;
+}
+
+// Checks the input as it is read, in pieces of at most --chunk-size
+// bytes, and stops reading at the first byte that makes it invalid. The
+// input is never held as a whole, so a pipe is checked while it is still
+// being written.
+INTERNAL void stream_file(char *file_path, settings *settings) {
+    int fd = STDIN_FILENO;
+    if (file_path != NULL) {
+        fd = open(file_path, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "ccjsonparser: file '%s' does not exist\n", file_path);
+            exit(0);
+        }
+    }
+    json_feeder feeder;
+    init_feeder(&feeder, settings->max_depth, START_STATE);
+    char *buffer = (char *)malloc(settings->chunk_size);
+    json_status status = JSON_INCOMPLETE;
+    while (status != JSON_INVALID) {
+        ssize_t n = read(fd, buffer, settings->chunk_size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            status = json_feed_end(&feeder);
+            break;
+        }
+        status = json_feed(&feeder, buffer, n);
+    }
+    if (!(settings->options & QUIET_OPTION)) {
+        printf("%s %s\n", file_path == NULL ? "stdin" : file_path, status == JSON_COMPLETE ? "valid" : "invalid");
+    }
+    free(buffer);
+    destroy_depth_stack(&feeder.stack);
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+}
+
+// Prints every value the --select path reaches, one per line as compact
+// JSON, as soon as it is found. Only the containers along the path go
+// through the grammar; any other subtree is skipped by matching brackets
+// over the structural index, without tokenizing it, so it is checked for
+// balance and for bytes stage 1 rejects, but not for its grammar.
+INTERNAL void select_file(char *file_path, settings *settings, depth_stack *stack) {
+    char_stream char_stream = create_char_stream(file_path);
+    token_stream token_stream = create_token_stream(&char_stream);
+    selector selector = create_selector(settings->select_path, stack);
+    token_type type = peek_token(&token_stream).type;
+    int res = (type == LEFT_BRACE_TOKEN || type == LEFT_BRACKET_TOKEN) && select_value(&selector, &token_stream, 0);
+    if (peek_token(&token_stream).type != EOF_TOKEN) {
+        res = 0;
+    }
+    if (!res && !(settings->options & QUIET_OPTION)) {
+        printf("%s invalid\n", file_path == NULL ? "stdin" : file_path);
+    }
+    destroy_selector(&selector);
     destroy_token_stream(&token_stream);
 }
 
-char is_whitespace(char c) {
-    char whitespaces[] = { ' ', '\t', '\n', '\v', '\f', '\r' };
-    for (int i = 0; i < 6; i++) {
-        if (c == *(whitespaces + i)) {
+// Splits a JSON Pointer ("/user/id", "/events/*/ts") into its segments,
+// turning "~1" back into '/' and "~0" into '~'. The empty path selects
+// the whole document.
+INTERNAL selector create_selector(char *path, depth_stack *stack) {
+    selector selector;
+    selector.count = 0;
+    for (char *c = path; *c != '\0'; c++) {
+        selector.count += *c == '/';
+    }
+    selector.segments = (path_segment *)malloc((selector.count + 1) * sizeof(path_segment));
+    selector.names = (char *)malloc(strlen(path) + 1);
+    selector.key_buffer = NULL;
+    selector.key_alloc = 0;
+    selector.stack = stack;
+    char *name = selector.names;
+    path_segment *segment = selector.segments - 1;
+    for (char *c = path; *c != '\0'; c++) {
+        if (*c == '/') {
+            segment++;
+            segment->name = name;
+            segment->len = 0;
+            continue;
+        }
+        if (*c == '~') {
+            c++;
+            *(name++) = *c == '1' ? '/' : '~';
+        } else {
+            *(name++) = *c;
+        }
+        segment->len++;
+    }
+    for (size_t i = 0; i < selector.count; i++) {
+        segment = selector.segments + i;
+        segment->wildcard = segment->len == 1 && *(segment->name) == '*';
+        // Array indexes are decimal, without leading zeros.
+        segment->index = segment->len > 0 && segment->len < 19 && (*(segment->name) != '0' || segment->len == 1) ? 0 : SIZE_MAX;
+        for (size_t j = 0; j < segment->len && segment->index != SIZE_MAX; j++) {
+            char c = *(segment->name + j);
+            segment->index = is_numeric(c) ? segment->index * 10 + (c - '0') : SIZE_MAX;
+        }
+    }
+    return selector;
+}
+
+INTERNAL void destroy_selector(selector *selector) {
+    free(selector->segments);
+    free(selector->names);
+    free(selector->key_buffer);
+}
+
+// Walks the value at the front of the token stream, which the path has
+// matched up to depth. Members and elements the next segment names are
+// walked in turn; the rest are skipped.
+INTERNAL int select_value(selector *selector, token_stream *token_stream, size_t depth) {
+    if (depth == selector->count) {
+        return select_matched(selector, token_stream, depth);
+    }
+    const char *data = token_stream->char_stream->data;
+    path_segment *segment = selector->segments + depth;
+    token token = next_token(token_stream);
+    if (token.type != LEFT_BRACE_TOKEN && token.type != LEFT_BRACKET_TOKEN) {
+        // A scalar has nothing under it to select.
+        return token.type == STRING_TOKEN || token.type == NUM_TOKEN || token.type == BOOL_TOKEN || token.type == NULL_TOKEN;
+    }
+    if (depth + 1 > selector->stack->max) {
+        return 0;
+    }
+    char is_array = token.type == LEFT_BRACE_TOKEN;
+    token_type close = is_array ? RIGHT_BRACE_TOKEN : RIGHT_BRACKET_TOKEN;
+    if (peek_token(token_stream).type == close) {
+        next_token(token_stream);
+        return 1;
+    }
+    for (size_t i = 0;; i++) {
+        char matches;
+        if (is_array) {
+            matches = segment->wildcard || segment->index == i;
+        } else {
+            token = next_token(token_stream);
+            if (token.type != STRING_TOKEN || next_token(token_stream).type != COLON_TOKEN) {
+                return 0;
+            }
+            matches = match_key(selector, segment, data, token);
+        }
+        int res = matches ? select_value(selector, token_stream, depth + 1) : skip_value(token_stream, depth + 1, selector->stack->max);
+        if (!res) {
+            return 0;
+        }
+        token = next_token(token_stream);
+        if (token.type == close) {
             return 1;
         }
+        if (token.type != COMMA_TOKEN) {
+            return 0;
+        }
     }
-    return 0;
 }
 
-char is_numeric(char c) {
+// Checks the selected value with the grammar, under what is left of the
+// depth limit, and prints it.
+INTERNAL int select_matched(selector *selector, token_stream *token_stream, size_t depth) {
+    const char *data = token_stream->char_stream->data;
+    size_t start = peek_token(token_stream).offset;
+    size_t max = selector->stack->max;
+    selector->stack->max = max - depth;
+    int res = check_document(token_stream, selector->stack, NULL, VALUE_STATE);
+    selector->stack->max = max;
+    if (res) {
+        print_compact(data, start, peek_token(token_stream).offset, stdout);
+        putchar('\n');
+    }
+    return res;
+}
+
+// Bracket depth change of each byte stage 1 indexes.
+static const int8_t bracket_depth[256] = {
+    ['['] = 1,
+    ['{'] = 1,
+    [']'] = -1,
+    ['}'] = -1,
+};
+
+// Skips the value at the front of the token stream. A container is passed
+// over by counting brackets in the structural offsets still to be read;
+// strings cannot hide brackets since stage 1 only indexes their quotes.
+INTERNAL int skip_value(token_stream *token_stream, size_t depth, size_t max_depth) {
+    token token = next_token(token_stream);
+    if (token.type != LEFT_BRACE_TOKEN && token.type != LEFT_BRACKET_TOKEN) {
+        return token.type == STRING_TOKEN || token.type == NUM_TOKEN || token.type == BOOL_TOKEN || token.type == NULL_TOKEN;
+    }
+    char is_array = token.type == LEFT_BRACE_TOKEN;
+    char_stream *cs = token_stream->char_stream;
+    structural_index *index = &token_stream->index;
+    const char *data = cs->data;
+    // The token after the open bracket has already been read.
+    token = peek_token(token_stream);
+    if (token.type == EOF_TOKEN) {
+        return 0;
+    }
+    size_t level = 1 + *(bracket_depth + (uint8_t)*(data + token.offset));
+    size_t pos = token.offset;
+    while (level > 0) {
+        if (depth + level > max_depth) {
+            return 0;
+        }
+        if (index->next == index->count) {
+            fill_index(index, cs);
+            if (index->next == index->count) {
+                return 0;
+            }
+        }
+        pos = *(index->offsets + index->next++);
+        level += *(bracket_depth + (uint8_t)*(data + pos));
+    }
+    // The brackets inside are only counted, but the outer pair must match.
+    if ((*(data + pos) == ']') != is_array || index->bad_char <= pos) {
+        return 0;
+    }
+    token_stream->curr = get_token(token_stream);
+    return 1;
+}
+
+// Compares an object key with a segment, decoding the key first if it has
+// escapes.
+INTERNAL char match_key(selector *selector, path_segment *segment, const char *data, token key) {
+    if (segment->wildcard) {
+        return 1;
+    }
+    const char *raw = data + key.offset + 1;
+    size_t len = key.len - 2;
+    if (memchr(raw, '\\', len) != NULL) {
+        if (len > selector->key_alloc) {
+            selector->key_alloc = len;
+            selector->key_buffer = (char *)realloc(selector->key_buffer, len);
+        }
+        len = decode_string(raw, len, selector->key_buffer);
+        raw = selector->key_buffer;
+    }
+    return len == segment->len && memcmp(raw, segment->name, len) == 0;
+}
+
+// Only the four whitespace characters the JSON grammar allows.
+INTERNAL char is_whitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+INTERNAL char is_structural(char c) {
+    return c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',';
+}
+
+INTERNAL char is_numeric(char c) {
     return c >= '0' && c <= '9';
 }
 
-char is_valid_escaping_char(char c) {
+INTERNAL char is_valid_escaping_char(char c) {
     char valid_espace_chars[] = { 'b', 'f', 'n', 'r', 't', '\"', '\\', '/' };
     for (int i = 0; i < 8; i++) {
         if (c == *(valid_espace_chars + i)) {
@@ -142,15 +814,15 @@ char is_valid_escaping_char(char c) {
     return 0;
 }
 
-char is_hex(char c) {
-    return c >= '0' && c <= '9' || c >= 'a' && c < 'f' || c >= 'A' && c <= 'F';
+INTERNAL char is_hex(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
 }
 
-char is_alpha(char c) {
+INTERNAL char is_alpha(char c) {
     return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
 }
 
-string *create_str(char *init) {
+INTERNAL string *create_str(char *init) {
     int len = 0;
     while (*(init + len) != '\0') {
         len++;
@@ -168,22 +840,12 @@ string *create_str(char *init) {
     return str;
 }
 
-void destroy_str(string *str) {
+INTERNAL void destroy_str(string *str) {
     free(str->buffer);
     free(str);
 }
 
-void push_c(string *str, char c) {
-    if (str->len + 2 > str->alloc * 100) {
-        str->alloc++;
-        str->buffer = (char *)realloc(str->buffer, str->alloc * 100);
-    }
-    *(str->buffer + str->len) = c;
-    str->len++;
-    *(str->buffer + str->len) = '\0';
-}
-
-char compare_str(string *str1, string *str2) {
+INTERNAL char compare_str(string *str1, string *str2) {
     if (str1->len != str2->len) {
         return 0;
     }
@@ -195,209 +857,663 @@ char compare_str(string *str1, string *str2) {
     return 1;
 }
 
-char_stream create_char_stream(char *file_path) {
+INTERNAL char_stream create_char_stream(char *file_path) {
     char_stream stream;
     if (file_path != NULL) {
-        FILE *file = NULL;
-        file = fopen(file_path, "r");
-        if (file == NULL) {
+        int fd = open(file_path, O_RDONLY);
+        if (fd < 0) {
             fprintf(stderr, "ccjsonparser: file '%s' does not exist\n", file_path);
             exit(0);
         }
-        stream.file = file;
+        stream.fd = fd;
     } else {
-        stream.file = stdin;
+        stream.fd = STDIN_FILENO;
+    }
+    stream.mapped = map_file(stream.fd, &stream.data, &stream.len);
+    if (!stream.mapped) {
+        read_all(&stream);
     }
-    stream.curr = fgetc(stream.file);
     return stream;
 }
 
-char next_char(token_stream *stream) {
-    char c = stream->char_stream->curr;
-    stream->char_stream->curr = fgetc(stream->char_stream->file);
-    return c;
-}
-
-char peek_char(token_stream *stream) {
-    return stream->char_stream->curr;
+// Maps a regular file read at offset zero. Anything else (pipes, terminals,
+// a stdin that was partly consumed) is left to the read path, and so is a
+// file that reports no size: /proc and sysfs files do, yet have content.
+INTERNAL char map_file(int fd, char **map, size_t *len) {
+    struct stat st;
+    *map = NULL;
+    *len = 0;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || lseek(fd, 0, SEEK_CUR) != 0 || st.st_size == 0) {
+        return 0;
+    }
+    void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        return 0;
+    }
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+    *map = (char *)addr;
+    *len = st.st_size;
+    return 1;
 }
 
-char is_char_stream_end(char_stream *stream) {
-    return stream->curr == EOF;
+// Reads the rest of the stream into an aligned buffer that doubles as it
+// fills, so the tokenizer always sees the document as one span.
+INTERNAL void read_all(char_stream *stream) {
+    size_t alloc = READ_BUFFER_SIZE;
+    char *data = NULL;
+    posix_memalign((void **)&data, BUFFER_ALIGNMENT, alloc);
+    size_t len = 0;
+    while (1) {
+        if (len == alloc) {
+            char *grown = NULL;
+            posix_memalign((void **)&grown, BUFFER_ALIGNMENT, alloc * 2);
+            memcpy(grown, data, len);
+            free(data);
+            data = grown;
+            alloc *= 2;
+        }
+        ssize_t n = read(stream->fd, data + len, alloc - len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        len += n;
+    }
+    stream->data = data;
+    stream->len = len;
 }
 
-void destroy_char_stream(char_stream *stream) {
-    fclose(stream->file);
+INTERNAL void destroy_char_stream(char_stream *stream) {
+    if (!stream->mapped) {
+        free(stream->data);
+    } else if (stream->data != NULL) {
+        munmap(stream->data, stream->len);
+    }
+    if (stream->fd != STDIN_FILENO) {
+        close(stream->fd);
+    }
 }
 
-token get_token(token_stream *ts) {
-    while (is_whitespace(peek_char(ts))) {
-        next_char(ts);
-    }
+// Tokens are read at the offsets stage 1 found, so whitespace is never
+// looked at again; nothing is copied or allocated, not even for keywords.
+INTERNAL token get_token(token_stream *ts) {
+    char_stream *cs = ts->char_stream;
+    structural_index *index = &ts->index;
+    const char *data = cs->data;
+    size_t len = cs->len;
     token token;
-    switch (peek_char(ts)) {
+    if (index->next == index->count) {
+        fill_index(index, cs);
+    }
+    if (index->next == index->count) {
+        token.type = index->bad_char == SIZE_MAX ? EOF_TOKEN : BAD_TOKEN;
+        token.offset = len;
+        token.len = 0;
+        return token;
+    }
+    size_t pos = *(index->offsets + index->next++);
+    size_t end = pos + 1;
+    token.offset = pos;
+    switch (*(data + pos)) {
         case '{':
-            next_char(ts);
             token.type = LEFT_BRACKET_TOKEN;
             break;
         case '}':
-            next_char(ts);
             token.type = RIGHT_BRACKET_TOKEN;
             break;
         case '[':
-            next_char(ts);
             token.type = LEFT_BRACE_TOKEN;
             break;
         case ']':
-            next_char(ts);
             token.type = RIGHT_BRACE_TOKEN;
             break;
+        case ':':
+            token.type = COLON_TOKEN;
+            break;
+        case ',':
+            token.type = COMMA_TOKEN;
+            break;
         case '"':
-            next_char(ts); // "
-            while (peek_char(ts) != EOF && peek_char(ts) != '"') {
-                if (peek_char(ts) == '\n' || peek_char(ts) == '\t') {
-                    token.type = BAD_TOKEN;
-                    return token;
-                }
-                if (peek_char(ts) == '\\')  {
-                    next_char(ts); // backslash
-                    if (peek_char(ts) == 'u') {
-                        next_char(ts); // u
-                        for (int i = 0; i < 4; i++) {
-                            if (!is_hex(peek_char(ts))) {
-                                token.type = BAD_TOKEN;
-                                return token;
-                            }
-                            next_char(ts);
-                        }
-                    } else if (!is_valid_escaping_char(peek_char(ts))) {
-                        token.type = BAD_TOKEN;
-                        return token;
-                    }
-                }
-                next_char(ts); // "
+            // The closing quote is the next offset, possibly in the next
+            // window. A string still open at the end of input has none.
+            if (index->next == index->count) {
+                fill_index(index, cs);
+            }
+            if (index->next == index->count) {
+                token.type = BAD_TOKEN;
+                break;
             }
-            if (next_char(ts) == EOF) {
+            end = *(index->offsets + index->next++) + 1;
+            if (!check_escapes(data, pos + 1, end - 1)) {
                 token.type = BAD_TOKEN;
             } else {
                 token.type = STRING_TOKEN;
             }
             break;
-        case ':':
-            next_char(ts);
-            token.type = COLON_TOKEN;
-            break;
-        case ',':
-            next_char(ts);
-            token.type = COMMA_TOKEN;
-            break;
-        case EOF:
-            next_char(ts);
-            token.type = EOF_TOKEN;
+        case 't':
+        case 'f':
+        case 'n':
+            token.type = match_keyword(data, len, pos, &end);
             break;
         default:
-            if (is_alpha(peek_char(ts))) {
-                string *keyword = create_str("");
-                while (is_alpha(peek_char(ts))) {
-                    char c = next_char(ts);
-                    push_c(keyword, c);
-                }
-                if (compare_str(keyword, null_str)) {
-                    token.type = NULL_TOKEN;
-                } else if (compare_str(keyword, true_str) || compare_str(keyword, false_str)) {
-                    token.type = BOOL_TOKEN;
-                }
-                destroy_str(keyword);
-            } else if (is_numeric(peek_char(ts)) || peek_char(ts) == '-') {
-                if (peek_char(ts) == '-') {
-                    next_char(ts); // -
-                }
-                if (peek_char(ts) == '0') {
-                    next_char(ts); // 0
-                    if (is_numeric(peek_char(ts))) {
-                        token.type = BAD_TOKEN;
-                        return token;
-                    }
-                }
-                while (is_numeric(peek_char(ts))) {
-                    next_char(ts); // num
-                }
-                if (peek_char(ts) == '.') {
-                    next_char(ts); // .
-                    if (!is_numeric(peek_char(ts))) {
-                        token.type = BAD_TOKEN;
-                        return token;
-                    }
-                    while (is_numeric(peek_char(ts))) {
-                        next_char(ts); // num
-                    }
-                }
-                if (peek_char(ts) == 'e' || peek_char(ts) == 'E') {
-                    next_char(ts); // e, E
-                    if (peek_char(ts) == '+' || peek_char(ts) == '-') {
-                        next_char(ts); // -, +
-                    }
-                    if (!is_numeric(peek_char(ts))) {
-                        token.type = BAD_TOKEN;
-                        return token;
-                    }
-                    while (is_numeric(peek_char(ts))) {
-                        next_char(ts); // num
-                    }
-                }
-                token.type = NUM_TOKEN;
+            if (is_numeric(*(data + pos)) || *(data + pos) == '-') {
+                end = scan_number(data, len, pos);
+                token.type = end == 0 ? BAD_TOKEN : NUM_TOKEN;
             } else {
-               token.type = BAD_TOKEN;
+                token.type = BAD_TOKEN;
             }
             break;
     }
+    // Stage 1 has already been over every byte up to this token's end.
+    if (index->bad_char < end) {
+        token.type = BAD_TOKEN;
+    }
+    // Stage 1 indexes only the first byte of a run of scalar bytes, so a
+    // number or keyword must end where that run does ("12ab", "1\"x\"").
+    if ((token.type == NUM_TOKEN || token.type == NULL_TOKEN || token.type == BOOL_TOKEN) && end < len && !is_whitespace(*(data + end)) && !is_structural(*(data + end))) {
+        token.type = BAD_TOKEN;
+    }
+    token.len = token.type == BAD_TOKEN ? 0 : end - pos;
     return token;
 }
 
-token_stream create_token_stream(char_stream *char_stream) {
+// Checks the escapes in the string contents between pos and end. Stage 1
+// has already found where the string ends, so only the backslashes are
+// visited.
+INTERNAL char check_escapes(const char *data, size_t pos, size_t end) {
+    while (pos < end) {
+        const char *backslash = memchr(data + pos, '\\', end - pos);
+        if (backslash == NULL) {
+            return 1;
+        }
+        pos = backslash - data + 1;
+        if (*(data + pos) == 'u') {
+            if (end - pos < 5) {
+                return 0;
+            }
+            for (int i = 1; i <= 4; i++) {
+                if (!is_hex(*(data + pos + i))) {
+                    return 0;
+                }
+            }
+            pos += 4;
+        } else if (!is_valid_escaping_char(*(data + pos))) {
+            return 0;
+        }
+        pos++;
+    }
+    return 1;
+}
+
+// Returns the offset just past the number starting at pos, or 0 if it is
+// malformed: a sign, fraction or exponent without digits, or a leading
+// zero followed by digits.
+INTERNAL size_t scan_number(const char *data, size_t len, size_t pos) {
+    if (*(data + pos) == '-') {
+        pos++;
+    }
+    if (pos >= len || !is_numeric(*(data + pos))) {
+        return 0;
+    }
+    if (*(data + pos) == '0') {
+        pos++;
+        if (pos < len && is_numeric(*(data + pos))) {
+            return 0;
+        }
+    }
+    pos = skip_digits(data, len, pos);
+    if (pos < len && *(data + pos) == '.') {
+        pos++;
+        if (pos >= len || !is_numeric(*(data + pos))) {
+            return 0;
+        }
+        pos = skip_digits(data, len, pos);
+    }
+    if (pos < len && (*(data + pos) == 'e' || *(data + pos) == 'E')) {
+        pos++;
+        if (pos < len && (*(data + pos) == '+' || *(data + pos) == '-')) {
+            pos++;
+        }
+        if (pos >= len || !is_numeric(*(data + pos))) {
+            return 0;
+        }
+        pos = skip_digits(data, len, pos);
+    }
+    return pos;
+}
+
+INTERNAL size_t skip_digits(const char *data, size_t len, size_t pos) {
+    while (pos < len && is_numeric(*(data + pos))) {
+        pos++;
+    }
+    return pos;
+}
+
+// Compares the 4 or 5 bytes at pos against each keyword. A keyword must
+// not run on into further letters ("nulls", "trueish").
+INTERNAL token_type match_keyword(const char *data, size_t len, size_t pos, size_t *end) {
+    size_t left = len - pos;
+    token_type type = BAD_TOKEN;
+    size_t keyword_len = 0;
+    if (left >= 4 && memcmp(data + pos, "null", 4) == 0) {
+        type = NULL_TOKEN;
+        keyword_len = 4;
+    } else if (left >= 4 && memcmp(data + pos, "true", 4) == 0) {
+        type = BOOL_TOKEN;
+        keyword_len = 4;
+    } else if (left >= 5 && memcmp(data + pos, "false", 5) == 0) {
+        type = BOOL_TOKEN;
+        keyword_len = 5;
+    }
+    if (type == BAD_TOKEN || (keyword_len < left && is_alpha(*(data + pos + keyword_len)))) {
+        return BAD_TOKEN;
+    }
+    *end = pos + keyword_len;
+    return type;
+}
+
+INTERNAL token_stream create_token_stream(char_stream *char_stream) {
     token_stream stream;
     stream.char_stream = char_stream;
+    init_structural_index(&stream.index);
     stream.curr = get_token(&stream);
     return stream;
 }
 
-token next_token(token_stream *token_stream) {
+// Points an existing token stream at another input, keeping its index.
+INTERNAL void reset_token_stream(token_stream *token_stream, char_stream *char_stream) {
+    token_stream->char_stream = char_stream;
+    reset_structural_index(&token_stream->index);
+    token_stream->curr = get_token(token_stream);
+}
+
+INTERNAL token next_token(token_stream *token_stream) {
     token t = token_stream->curr;
     token_stream->curr = get_token(token_stream);
     return t;
 }
 
-token peek_token(token_stream *token_stream) {
+INTERNAL token peek_token(token_stream *token_stream) {
     return token_stream->curr;
 }
 
-void destroy_token_stream(token_stream *token_stream) {
+INTERNAL void destroy_token_stream(token_stream *token_stream) {
+    free(token_stream->index.offsets);
     destroy_char_stream(token_stream->char_stream);
 }
 
-void print_token(token *token) {
-    switch (token->type) {
-        case LEFT_BRACKET_TOKEN:
-            printf("LEFT BRACKET TOKEN\n");
-            break;
-        case RIGHT_BRACKET_TOKEN:
-            printf("RIGHT BRACKET TOKEN\n");
-            break;
-        case RIGHT_BRACE_TOKEN:
-            printf("RIGHT BRACE TOKEN\n");
-            break;
-        case LEFT_BRACE_TOKEN:
-            printf("LEFT BRACE TOKEN\n");
-            break;
-        case COLON_TOKEN:
-            printf("COLON TOKEN\n");
-            break;
-        case STRING_TOKEN:
-            printf("STRING TOKEN\n");
-            break;
-        case COMMA_TOKEN:
-            printf("COMMA TOKEN\n");
-            break;
+INTERNAL void init_structural_index(structural_index *index) {
+    index->offsets = (size_t *)malloc(INDEX_CAPACITY * sizeof(size_t));
+    index->classify = select_block_kernel();
+    index->validate_utf8 = select_utf8_kernel();
+    reset_structural_index(index);
+}
+
+INTERNAL void reset_structural_index(structural_index *index) {
+    index->count = 0;
+    index->next = 0;
+    index->indexed = 0;
+    index->bad_char = SIZE_MAX;
+    index->utf8_carry = 0;
+    index->in_string = 0;
+    index->escaped = 0;
+    index->scalar = 0;
+}
+
+// Runs stage 1 over the next blocks of the input until the index is full
+// or the input ends. The last, partial block is padded with spaces.
+INTERNAL void fill_index(structural_index *index, char_stream *cs) {
+    // Kept in locals: the offsets written below could otherwise alias the
+    // index's own fields and force them to be reloaded after every store.
+    size_t *out = index->offsets;
+    size_t *room_end = index->offsets + INDEX_CAPACITY - 64;
+    size_t block = index->indexed;
+    size_t len = cs->len;
+    while (block < len && out <= room_end) {
+        block_masks masks;
+        const char *bytes = cs->data + block;
+        char padded[64];
+        if (len - block < 64) {
+            memset(padded, ' ', sizeof(padded));
+            memcpy(padded, bytes, len - block);
+            bytes = padded;
+        }
+        index->classify(bytes, &masks);
+        uint64_t bad_chars;
+        uint64_t structurals = find_structurals(index, &masks, &bad_chars);
+        bad_chars |= index->validate_utf8(bytes, &index->utf8_carry);
+        if (bad_chars != 0 && index->bad_char == SIZE_MAX) {
+            index->bad_char = block + __builtin_ctzll(bad_chars);
+        }
+        size_t *block_end = out + __builtin_popcountll(structurals);
+        // Offsets are written eight at a time whether or not there are that
+        // many left, so the loop count rarely changes from block to block.
+        // At most 64 are written, which the room check above leaves for.
+        while (structurals != 0) {
+            for (int i = 0; i < 8; i++) {
+                *(out + i) = block + __builtin_ctzll(structurals | (1ULL << 63));
+                structurals &= structurals - 1;
+            }
+            out += 8;
+        }
+        out = block_end;
+        block += 64;
+    }
+    // Input that ends on a block boundary gets no padded block, so a UTF-8
+    // sequence left open by the last byte is found with a block of spaces.
+    if (block == len) {
+        char spaces[64];
+        memset(spaces, ' ', sizeof(spaces));
+        if (index->validate_utf8(spaces, &index->utf8_carry) != 0 && index->bad_char == SIZE_MAX) {
+            index->bad_char = len;
+        }
+    }
+    index->indexed = block < len ? block : len;
+    index->count = out - index->offsets;
+    index->next = 0;
+}
+
+// The simdjson stage 1 recipe. Escaped quotes are dropped, the prefix XOR
+// of the remaining quotes marks the bytes inside strings, and a byte is
+// indexed if it is a quote, a structural character outside a string, or
+// the first byte of a run of scalar bytes (numbers, keywords, and anything
+// invalid). Control characters inside strings are returned in bad_chars.
+// State that spans blocks is carried in index.
+INTERNAL uint64_t find_structurals(structural_index *index, block_masks *masks, uint64_t *bad_chars) {
+    uint64_t escaped = find_escaped(masks->backslash, &index->escaped);
+    uint64_t quote = masks->quote & ~escaped;
+    uint64_t in_string = prefix_xor(quote) ^ index->in_string;
+    index->in_string = (uint64_t)((int64_t)in_string >> 63);
+    uint64_t scalar = ~(masks->structural | masks->whitespace);
+    uint64_t nonquote_scalar = scalar & ~quote;
+    uint64_t follows_scalar = nonquote_scalar << 1 | index->scalar;
+    index->scalar = nonquote_scalar >> 63;
+    uint64_t scalar_start = scalar & ~follows_scalar;
+    *bad_chars = masks->control & in_string;
+    return ((masks->structural | scalar_start) & ~in_string) | quote;
+}
+
+// Returns the bytes escaped by a backslash: those following an odd-length
+// run of backslashes. *escaped carries whether the next block's first
+// byte is escaped.
+INTERNAL uint64_t find_escaped(uint64_t backslash, uint64_t *escaped) {
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    backslash &= ~*escaped;
+    uint64_t follows_escape = backslash << 1 | *escaped;
+    uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+    uint64_t even_starts;
+    *escaped = __builtin_add_overflow(odd_starts, backslash, &even_starts);
+    uint64_t invert = even_starts << 1;
+    return (even_bits ^ invert) & follows_escape;
+}
+
+// Bit i of the result is the XOR of bits 0 to i.
+INTERNAL uint64_t prefix_xor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+INTERNAL block_kernel select_block_kernel() {
+#ifdef HAS_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return classify_block_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return classify_block_sse2;
+    }
+#endif
+    return classify_block_scalar;
+}
+
+INTERNAL utf8_kernel select_utf8_kernel() {
+#ifdef HAS_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return validate_utf8_avx2;
+    }
+#endif
+    return validate_utf8_scalar;
+}
+
+INTERNAL void classify_block_scalar(const char *block, block_masks *masks) {
+    masks->backslash = 0;
+    masks->quote = 0;
+    masks->whitespace = 0;
+    masks->structural = 0;
+    masks->control = 0;
+    for (int i = 0; i < 64; i++) {
+        char c = *(block + i);
+        masks->backslash |= (uint64_t)(c == '\\') << i;
+        masks->quote |= (uint64_t)(c == '"') << i;
+        masks->whitespace |= (uint64_t)is_whitespace(c) << i;
+        masks->structural |= (uint64_t)is_structural(c) << i;
+        masks->control |= (uint64_t)((unsigned char)c < 0x20) << i;
+    }
+}
+
+// Byte classes and transitions of Bjoern Hoehrmann's UTF-8 decoder, as in
+// wc. States are multiples of 12 so a state plus a class indexes the
+// transitions.
+static const uint8_t utf8_classes[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    8, 8, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    10, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 4, 3, 3, 11, 6, 6, 6, 5, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+};
+
+static const uint8_t utf8_transitions[108] = {
+    0, 12, 24, 36, 60, 96, 84, 12, 12, 12, 48, 72,
+    12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,
+    12, 0, 12, 12, 12, 12, 12, 0, 12, 0, 12, 12,
+    12, 24, 12, 12, 12, 12, 12, 24, 12, 24, 12, 12,
+    12, 12, 12, 12, 12, 12, 12, 24, 12, 12, 12, 12,
+    12, 24, 12, 12, 12, 12, 12, 12, 12, 24, 12, 12,
+    12, 12, 12, 12, 12, 12, 12, 36, 12, 36, 12, 12,
+    12, 36, 12, 12, 12, 12, 12, 36, 12, 36, 12, 12,
+    12, 36, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,
+};
+
+// Runs the DFA over the block; the carry is its state. A block of ASCII
+// with no sequence open is skipped eight bytes at a time.
+INTERNAL uint64_t validate_utf8_scalar(const char *block, uint32_t *carry) {
+    uint32_t state = *carry;
+    if (state == UTF8_ACCEPT) {
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; i++) {
+            uint64_t word;
+            memcpy(&word, block + i * 8, sizeof(word));
+            bits |= word;
+        }
+        if ((bits & 0x8080808080808080ULL) == 0) {
+            return 0;
+        }
+    }
+    uint64_t errors = 0;
+    for (int i = 0; i < 64; i++) {
+        state = *(utf8_transitions + state + *(utf8_classes + (unsigned char)*(block + i)));
+        if (state == UTF8_REJECT) {
+            errors |= 1ULL << i;
+            state = UTF8_ACCEPT;
+        }
+    }
+    *carry = state;
+    return errors;
+}
+
+#ifdef HAS_X86_KERNELS
+INTERNAL void classify_block_sse2(const char *block, block_masks *masks) {
+    masks->backslash = 0;
+    masks->quote = 0;
+    masks->whitespace = 0;
+    masks->structural = 0;
+    masks->control = 0;
+    for (int j = 0; j < 4; j++) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(block + j * 16));
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+        // Unsigned v < 0x20 is min(v, 0x1f) == v.
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1f)), v);
+        // '[' and ']' differ from '{' and '}' only in bit 0x20, so setting
+        // it lets one comparison find both kinds of bracket.
+        __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+        masks->backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << (j * 16);
+        masks->quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << (j * 16);
+        masks->whitespace |= (uint64_t)(uint16_t)_mm_movemask_epi8(ws) << (j * 16);
+        masks->structural |= (uint64_t)(uint16_t)_mm_movemask_epi8(op) << (j * 16);
+        masks->control |= (uint64_t)(uint16_t)_mm_movemask_epi8(control) << (j * 16);
+    }
+}
+
+__attribute__((target("avx2")))
+INTERNAL void classify_block_avx2(const char *block, block_masks *masks) {
+    masks->backslash = 0;
+    masks->quote = 0;
+    masks->whitespace = 0;
+    masks->structural = 0;
+    masks->control = 0;
+    for (int j = 0; j < 2; j++) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(block + j * 32));
+        __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+        __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1f)), v);
+        __m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i op = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))));
+        masks->backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << (j * 32);
+        masks->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))) << (j * 32);
+        masks->whitespace |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ws) << (j * 32);
+        masks->structural |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op) << (j * 32);
+        masks->control |= (uint64_t)(uint32_t)_mm256_movemask_epi8(control) << (j * 32);
+    }
+}
+
+// The error classes of the Keiser-Lemire lookup algorithm. Each table below
+// maps a nibble of a byte pair to the errors it allows; a pair is invalid
+// when all three agree. TWO_CONTINUATIONS is not an error by itself: it
+// must line up with the bytes a 3 or 4 byte lead says are continuations.
+#define UTF8_TOO_SHORT (1 << 0)
+#define UTF8_TOO_LONG (1 << 1)
+#define UTF8_OVERLONG_3 (1 << 2)
+#define UTF8_TOO_LARGE (1 << 3)
+#define UTF8_SURROGATE (1 << 4)
+#define UTF8_OVERLONG_2 (1 << 5)
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4 (1 << 6)
+#define UTF8_TWO_CONTINUATIONS (1 << 7)
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTINUATIONS)
+
+// v shifted up by n bytes, with the bytes of prev shifted in below it.
+#define PREV_BYTES(v, prev, n) _mm256_alignr_epi8((v), _mm256_permute2x128_si256((prev), (v), 0x21), 16 - (n))
+
+#define TABLE16(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+__attribute__((target("avx2")))
+INTERNAL __m256i check_utf8_half(__m256i v, __m256i prev) {
+    const __m256i byte_1_high_table = TABLE16(
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TWO_CONTINUATIONS, UTF8_TWO_CONTINUATIONS, UTF8_TWO_CONTINUATIONS, UTF8_TWO_CONTINUATIONS,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+        UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+        UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4);
+    const __m256i byte_1_low_table = TABLE16(
+        UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+        UTF8_CARRY | UTF8_OVERLONG_2,
+        UTF8_CARRY,
+        UTF8_CARRY,
+        UTF8_CARRY | UTF8_TOO_LARGE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000);
+    const __m256i byte_2_high_table = TABLE16(
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT);
+    const __m256i low_nibble = _mm256_set1_epi8(0x0f);
+    __m256i prev1 = PREV_BYTES(v, prev, 1);
+    __m256i byte_1_high = _mm256_shuffle_epi8(byte_1_high_table, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), low_nibble));
+    __m256i byte_1_low = _mm256_shuffle_epi8(byte_1_low_table, _mm256_and_si256(prev1, low_nibble));
+    __m256i byte_2_high = _mm256_shuffle_epi8(byte_2_high_table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibble));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+    // Only a byte two after a 3 or 4 byte lead, or three after a 4 byte
+    // lead, comes out of the subtraction with its top bit set.
+    __m256i third = _mm256_subs_epu8(PREV_BYTES(v, prev, 2), _mm256_set1_epi8((char)(0xe0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(PREV_BYTES(v, prev, 3), _mm256_set1_epi8((char)(0xf0 - 0x80)));
+    __m256i must_continue = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must_continue, special);
+}
+
+// The carry is the last four bytes of the block before, enough to finish
+// checking a sequence it left open. A block of ASCII only needs to know
+// that no sequence was left open.
+__attribute__((target("avx2")))
+INTERNAL uint64_t validate_utf8_avx2(const char *block, uint32_t *carry) {
+    __m256i lo = _mm256_loadu_si256((const __m256i *)block);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(block + 32));
+    uint32_t prev_bytes = *carry;
+    memcpy(carry, block + 60, sizeof(*carry));
+    if (_mm256_movemask_epi8(_mm256_or_si256(lo, hi)) == 0) {
+        char open = (prev_bytes >> 24) >= 0xc0 || ((prev_bytes >> 16) & 0xff) >= 0xe0 || ((prev_bytes >> 8) & 0xff) >= 0xf0;
+        return open;
+    }
+    __m256i prev = _mm256_set_epi32((int)prev_bytes, 0, 0, 0, 0, 0, 0, 0);
+    __m256i zero = _mm256_setzero_si256();
+    uint64_t errors = (uint32_t)~_mm256_movemask_epi8(_mm256_cmpeq_epi8(check_utf8_half(lo, prev), zero));
+    errors |= (uint64_t)(uint32_t)~_mm256_movemask_epi8(_mm256_cmpeq_epi8(check_utf8_half(hi, lo), zero)) << 32;
+    return errors;
+}
+#endif
+
+INTERNAL void print_token(token *token) {
+    switch (token->type) {
+        case LEFT_BRACKET_TOKEN:
+            printf("LEFT BRACKET TOKEN\n");
+            break;
+        case RIGHT_BRACKET_TOKEN:
+            printf("RIGHT BRACKET TOKEN\n");
+            break;
+        case RIGHT_BRACE_TOKEN:
+            printf("RIGHT BRACE TOKEN\n");
+            break;
+        case LEFT_BRACE_TOKEN:
+            printf("LEFT BRACE TOKEN\n");
+            break;
+        case COLON_TOKEN:
+            printf("COLON TOKEN\n");
+            break;
+        case STRING_TOKEN:
+            printf("STRING TOKEN\n");
+            break;
+        case COMMA_TOKEN:
+            printf("COMMA TOKEN\n");
+            break;
         case NULL_TOKEN:
             printf("NULL TOKEN\n");
             break;
@@ -416,136 +1532,1738 @@ void print_token(token *token) {
     }
 }
 
-int check_initial_expression(token_stream *token_stream) {
-    token token = peek_token(token_stream);
-    if (token.type == LEFT_BRACE_TOKEN) {
-        return check_array_expression(token_stream, 1);
-    } else if (token.type == LEFT_BRACKET_TOKEN) {
-        return check_object_expression(token_stream, 1);
-    } else {
+INTERNAL depth_stack create_depth_stack(size_t max) {
+    depth_stack stack;
+    stack.alloc = max < DEPTH_STACK_SIZE ? max : DEPTH_STACK_SIZE;
+    stack.states = (uint8_t *)malloc(stack.alloc > 0 ? stack.alloc : 1);
+    stack.len = 0;
+    stack.max = max;
+    return stack;
+}
+
+// Returns 0 if the container would nest deeper than the stack allows.
+INTERNAL char push_depth(depth_stack *stack, uint8_t state) {
+    if (stack->len == stack->max) {
         return 0;
     }
+    if (stack->len == stack->alloc) {
+        stack->alloc = stack->alloc * 2 < stack->max ? stack->alloc * 2 : stack->max;
+        stack->states = (uint8_t *)realloc(stack->states, stack->alloc);
+    }
+    *(stack->states + stack->len++) = state;
+    return 1;
 }
 
-int check_expression(token_stream *token_stream, int depth) {
-    token token = peek_token(token_stream);
-    if (token.type == NULL_TOKEN) {
-        next_token(token_stream);
-        return 1;
-    } else if (token.type == NUM_TOKEN) {
-        next_token(token_stream);
-        return 1;
-    } else if (token.type == BOOL_TOKEN) {
-        next_token(token_stream);
-        return 1;
-    } else if (token.type == STRING_TOKEN) {
-        next_token(token_stream);
-        return 1;
-    } else if (token.type == LEFT_BRACE_TOKEN) {
-        return check_array_expression(token_stream, depth);
-    } else if (token.type == LEFT_BRACKET_TOKEN) {
-        return check_object_expression(token_stream, depth);
-    } else {
-        return 0;
+INTERNAL void destroy_depth_stack(depth_stack *stack) {
+    free(stack->states);
+}
+
+// The grammar as a table: the move each token makes in each state.
+static const uint8_t grammar_moves[GRAMMAR_STATE_COUNT][BAD_TOKEN + 1] = {
+    [START_STATE] = {
+        [LEFT_BRACE_TOKEN] = OPEN_ARRAY_MOVE,
+        [LEFT_BRACKET_TOKEN] = OPEN_OBJECT_MOVE,
+    },
+    [VALUE_STATE] = {
+        [LEFT_BRACE_TOKEN] = OPEN_ARRAY_MOVE,
+        [LEFT_BRACKET_TOKEN] = OPEN_OBJECT_MOVE,
+        [STRING_TOKEN] = SCALAR_MOVE,
+        [NUM_TOKEN] = SCALAR_MOVE,
+        [BOOL_TOKEN] = SCALAR_MOVE,
+        [NULL_TOKEN] = SCALAR_MOVE,
+    },
+    [ARRAY_FIRST_STATE] = {
+        [LEFT_BRACE_TOKEN] = OPEN_ARRAY_MOVE,
+        [LEFT_BRACKET_TOKEN] = OPEN_OBJECT_MOVE,
+        [STRING_TOKEN] = SCALAR_MOVE,
+        [NUM_TOKEN] = SCALAR_MOVE,
+        [BOOL_TOKEN] = SCALAR_MOVE,
+        [NULL_TOKEN] = SCALAR_MOVE,
+        [RIGHT_BRACE_TOKEN] = CLOSE_MOVE,
+    },
+    [ARRAY_NEXT_STATE] = {
+        [COMMA_TOKEN] = ARRAY_COMMA_MOVE,
+        [RIGHT_BRACE_TOKEN] = CLOSE_MOVE,
+    },
+    [OBJECT_FIRST_STATE] = {
+        [STRING_TOKEN] = KEY_MOVE,
+        [RIGHT_BRACKET_TOKEN] = CLOSE_MOVE,
+    },
+    [OBJECT_KEY_STATE] = {
+        [STRING_TOKEN] = KEY_MOVE,
+    },
+    [OBJECT_COLON_STATE] = {
+        [COLON_TOKEN] = COLON_MOVE,
+    },
+    [OBJECT_NEXT_STATE] = {
+        [COMMA_TOKEN] = OBJECT_COMMA_MOVE,
+        [RIGHT_BRACKET_TOKEN] = CLOSE_MOVE,
+    },
+};
+
+// Checks one document, an array or an object.
+INTERNAL int check_initial_expression(token_stream *token_stream, depth_stack *stack, dom *dom) {
+    return check_document(token_stream, stack, dom, START_STATE);
+}
+
+// Drives the grammar table from the start state with an explicit stack
+// instead of recursion, so the depth is bounded by the stack's limit and
+// not by the C stack. Stops right after the document's last token. Given
+// a dom, the document is also built into it.
+INTERNAL int check_document(token_stream *token_stream, depth_stack *stack, dom *dom, uint8_t start) {
+    const char *data = token_stream->char_stream->data;
+    uint8_t state = start;
+    stack->len = 0;
+    while (1) {
+        token token = next_token(token_stream);
+        switch (*(*(grammar_moves + state) + token.type)) {
+            case SCALAR_MOVE:
+                if (dom != NULL && !append_value(dom, data, token)) {
+                    return 0;
+                }
+                if (stack->len == 0) {
+                    return 1;
+                }
+                state = *(stack->states + stack->len - 1);
+                break;
+            case OPEN_ARRAY_MOVE:
+                if (!push_depth(stack, ARRAY_NEXT_STATE)) {
+                    return 0;
+                }
+                if (dom != NULL) {
+                    append_open(dom, '[');
+                }
+                state = ARRAY_FIRST_STATE;
+                break;
+            case OPEN_OBJECT_MOVE:
+                if (!push_depth(stack, OBJECT_NEXT_STATE)) {
+                    return 0;
+                }
+                if (dom != NULL) {
+                    append_open(dom, '{');
+                }
+                state = OBJECT_FIRST_STATE;
+                break;
+            case CLOSE_MOVE:
+                if (dom != NULL) {
+                    append_close(dom, token.type == RIGHT_BRACE_TOKEN ? ']' : '}');
+                }
+                stack->len--;
+                if (stack->len == 0) {
+                    return 1;
+                }
+                state = *(stack->states + stack->len - 1);
+                break;
+            case KEY_MOVE:
+                if (dom != NULL) {
+                    append_string(dom, 'k', data + token.offset + 1, token.len - 2);
+                }
+                state = OBJECT_COLON_STATE;
+                break;
+            case COLON_MOVE:
+                state = VALUE_STATE;
+                break;
+            case ARRAY_COMMA_MOVE:
+                state = VALUE_STATE;
+                break;
+            case OBJECT_COMMA_MOVE:
+                state = OBJECT_KEY_STATE;
+                break;
+            default:
+                return 0;
+        }
     }
 }
 
-int check_array_expression(token_stream *token_stream, int depth) {
-    depth++;
-    if (depth > MAX_DEPTH) {
-        return 0;
+json_parser *json_parser_create(const char *data, size_t len, size_t max_depth) {
+    json_parser *parser = (json_parser *)malloc(sizeof(json_parser));
+    // The input is only read; it stays the caller's.
+    parser->char_stream.data = (char *)data;
+    parser->char_stream.len = len;
+    parser->char_stream.mapped = 0;
+    parser->char_stream.fd = -1;
+    parser->token_stream = create_token_stream(&parser->char_stream);
+    parser->stack = create_depth_stack(max_depth);
+    parser->state = VALUE_STATE;
+    parser->progress = PARSING_PROGRESS;
+    return parser;
+}
+
+// check_document one token at a time: separators only move the grammar
+// on, every other token is returned as an event.
+json_event json_parser_next(json_parser *parser) {
+    token_stream *token_stream = &parser->token_stream;
+    depth_stack *stack = &parser->stack;
+    const char *data = parser->char_stream.data;
+    json_event event;
+    if (parser->progress != PARSING_PROGRESS) {
+        event.type = parser->progress == DONE_PROGRESS ? JSON_DONE : JSON_ERROR;
+        event.raw = data + peek_token(token_stream).offset;
+        event.len = 0;
+        return event;
     }
-    token left_brace = next_token(token_stream); // [
-    if (left_brace.type != LEFT_BRACE_TOKEN) {
-        return 0;
+    while (1) {
+        token token = next_token(token_stream);
+        event.raw = data + token.offset;
+        event.len = token.len;
+        switch (*(*(grammar_moves + parser->state) + token.type)) {
+            case SCALAR_MOVE:
+                if (token.type == STRING_TOKEN) {
+                    event.type = JSON_STRING;
+                    event.raw++;
+                    event.len -= 2;
+                } else if (token.type == NUM_TOKEN) {
+                    event.type = JSON_NUMBER;
+                } else if (token.type == NULL_TOKEN) {
+                    event.type = JSON_NULL;
+                } else {
+                    event.type = *(event.raw) == 't' ? JSON_TRUE : JSON_FALSE;
+                }
+                break;
+            case OPEN_ARRAY_MOVE:
+            case OPEN_OBJECT_MOVE:
+                if (!push_depth(stack, token.type == LEFT_BRACE_TOKEN ? ARRAY_NEXT_STATE : OBJECT_NEXT_STATE)) {
+                    event.type = JSON_ERROR;
+                    event.len = 0;
+                    parser->progress = FAILED_PROGRESS;
+                    return event;
+                }
+                event.type = token.type == LEFT_BRACE_TOKEN ? JSON_START_ARRAY : JSON_START_OBJECT;
+                parser->state = token.type == LEFT_BRACE_TOKEN ? ARRAY_FIRST_STATE : OBJECT_FIRST_STATE;
+                return event;
+            case CLOSE_MOVE:
+                event.type = token.type == RIGHT_BRACE_TOKEN ? JSON_END_ARRAY : JSON_END_OBJECT;
+                stack->len--;
+                break;
+            case KEY_MOVE:
+                event.type = JSON_KEY;
+                event.raw++;
+                event.len -= 2;
+                parser->state = OBJECT_COLON_STATE;
+                return event;
+            case COLON_MOVE:
+            case ARRAY_COMMA_MOVE:
+                parser->state = VALUE_STATE;
+                continue;
+            case OBJECT_COMMA_MOVE:
+                parser->state = OBJECT_KEY_STATE;
+                continue;
+            default:
+                event.type = JSON_ERROR;
+                event.len = 0;
+                parser->progress = FAILED_PROGRESS;
+                return event;
+        }
+        // A value is complete: resume the container around it, or end
+        // the document, which must then be all the input.
+        if (stack->len > 0) {
+            parser->state = *(stack->states + stack->len - 1);
+        } else {
+            parser->progress = peek_token(token_stream).type == EOF_TOKEN ? DONE_PROGRESS : FAILED_PROGRESS;
+        }
+        return event;
     }
-    int res = 1;
-    while (peek_token(token_stream).type != RIGHT_BRACE_TOKEN) {
-        res = res && check_expression(token_stream, depth);
-        if (!res) {
-            return 0;
+}
+
+void json_parser_destroy(json_parser *parser) {
+    free(parser->token_stream.index.offsets);
+    destroy_depth_stack(&parser->stack);
+    free(parser);
+}
+
+int json_parse(const char *data, size_t len, size_t max_depth, json_handler handler, void *context) {
+    json_parser *parser = json_parser_create(data, len, max_depth);
+    int res = -1;
+    while (1) {
+        json_event event = json_parser_next(parser);
+        if (event.type == JSON_DONE || event.type == JSON_ERROR) {
+            res = event.type == JSON_DONE;
+            break;
         }
-        token comma_token = peek_token(token_stream);
-        if (comma_token.type != COMMA_TOKEN && comma_token.type != RIGHT_BRACE_TOKEN) {
-            return 0;
+        if (!handler(&event, context)) {
+            break;
         }
-        if (comma_token.type == COMMA_TOKEN) {
-            next_token(token_stream); // ,
-            if (peek_token(token_stream).type == RIGHT_BRACE_TOKEN) {
+    }
+    json_parser_destroy(parser);
+    return res;
+}
+
+size_t json_decode_string(const json_event *event, char *out) {
+    return decode_string(event->raw, event->len, out);
+}
+
+int json_number(const json_event *event, int64_t *integer, double *real) {
+    return parse_number(event->raw, event->len, integer, real) == 'l';
+}
+
+json_feeder *json_feeder_create(size_t max_depth) {
+    json_feeder *feeder = (json_feeder *)malloc(sizeof(json_feeder));
+    init_feeder(feeder, max_depth, VALUE_STATE);
+    return feeder;
+}
+
+INTERNAL void init_feeder(json_feeder *feeder, size_t max_depth, uint8_t start) {
+    feeder->stack = create_depth_stack(max_depth);
+    feeder->state = start;
+    feeder->lexer = BETWEEN_LEX;
+    feeder->hex_left = 0;
+    feeder->utf8 = UTF8_ACCEPT;
+    feeder->keyword = NULL;
+    feeder->finished = 0;
+    feeder->failed = 0;
+}
+
+json_status json_feed(json_feeder *feeder, const char *data, size_t len) {
+    if (feeder->failed) {
+        return JSON_INVALID;
+    }
+    size_t pos = 0;
+    while (pos < len) {
+        unsigned char c = *(data + pos);
+        switch (feeder->lexer) {
+            case BETWEEN_LEX:
+                if (!is_whitespace(c) && (feeder->finished || !start_token(feeder, c))) {
+                    feeder->failed = 1;
+                    return JSON_INVALID;
+                }
+                break;
+            case STRING_LEX:
+                if (c >= 0x80 || feeder->utf8 != UTF8_ACCEPT) {
+                    feeder->utf8 = *(utf8_transitions + feeder->utf8 + *(utf8_classes + c));
+                    feeder->failed = feeder->utf8 == UTF8_REJECT;
+                } else if (c == '"') {
+                    feeder->lexer = BETWEEN_LEX;
+                } else if (c == '\\') {
+                    feeder->lexer = ESCAPE_LEX;
+                } else if (c < 0x20) {
+                    feeder->failed = 1;
+                } else {
+                    // The rest of a run of plain ASCII in one step.
+                    while (pos + 1 < len && (c = *(data + pos + 1)) >= 0x20 && c < 0x80 && c != '"' && c != '\\') {
+                        pos++;
+                    }
+                }
+                break;
+            case ESCAPE_LEX:
+                if (c == 'u') {
+                    feeder->lexer = HEX_LEX;
+                    feeder->hex_left = 4;
+                } else {
+                    feeder->lexer = STRING_LEX;
+                    feeder->failed = !is_valid_escaping_char(c);
+                }
+                break;
+            case HEX_LEX:
+                feeder->failed = !is_hex(c);
+                if (--feeder->hex_left == 0) {
+                    feeder->lexer = STRING_LEX;
+                }
+                break;
+            case MINUS_LEX:
+                feeder->lexer = c == '0' ? ZERO_LEX : INTEGER_LEX;
+                feeder->failed = !is_numeric(c);
+                break;
+            case DOT_LEX:
+                feeder->lexer = FRACTION_LEX;
+                feeder->failed = !is_numeric(c);
+                break;
+            case EXPONENT_MARK_LEX:
+                if (c == '+' || c == '-') {
+                    feeder->lexer = EXPONENT_SIGN_LEX;
+                    break;
+                }
+                feeder->lexer = EXPONENT_LEX;
+                feeder->failed = !is_numeric(c);
+                break;
+            case EXPONENT_SIGN_LEX:
+                feeder->lexer = EXPONENT_LEX;
+                feeder->failed = !is_numeric(c);
+                break;
+            case KEYWORD_LEX:
+                feeder->failed = c != *(feeder->keyword);
+                if (*(++feeder->keyword) == '\0') {
+                    feeder->lexer = BETWEEN_LEX;
+                }
+                break;
+            default:
+                // ZERO_LEX, INTEGER_LEX, FRACTION_LEX or EXPONENT_LEX: the
+                // number goes on, or ends where this byte starts something
+                // else (a digit after a leading zero starts a number the
+                // grammar rejects).
+                if (is_numeric(c) && feeder->lexer != ZERO_LEX) {
+                    break;
+                }
+                if (c == '.' && (feeder->lexer == ZERO_LEX || feeder->lexer == INTEGER_LEX)) {
+                    feeder->lexer = DOT_LEX;
+                } else if ((c == 'e' || c == 'E') && feeder->lexer != EXPONENT_LEX) {
+                    feeder->lexer = EXPONENT_MARK_LEX;
+                } else {
+                    feeder->lexer = BETWEEN_LEX;
+                    continue;
+                }
+                break;
+        }
+        if (feeder->failed) {
+            return JSON_INVALID;
+        }
+        pos++;
+    }
+    return feeder_status(feeder);
+}
+
+// Applies the grammar move of the token c starts, and sets up the lexer
+// for the rest of it.
+INTERNAL char start_token(json_feeder *feeder, char c) {
+    token_type type;
+    switch (c) {
+        case '{':
+            type = LEFT_BRACKET_TOKEN;
+            break;
+        case '}':
+            type = RIGHT_BRACKET_TOKEN;
+            break;
+        case '[':
+            type = LEFT_BRACE_TOKEN;
+            break;
+        case ']':
+            type = RIGHT_BRACE_TOKEN;
+            break;
+        case ':':
+            type = COLON_TOKEN;
+            break;
+        case ',':
+            type = COMMA_TOKEN;
+            break;
+        case '"':
+            type = STRING_TOKEN;
+            feeder->lexer = STRING_LEX;
+            break;
+        case 't':
+        case 'f':
+        case 'n':
+            type = c == 'n' ? NULL_TOKEN : BOOL_TOKEN;
+            feeder->lexer = KEYWORD_LEX;
+            feeder->keyword = c == 't' ? "rue" : c == 'f' ? "alse" : "ull";
+            break;
+        default:
+            if (c != '-' && !is_numeric(c)) {
                 return 0;
             }
-        }
+            type = NUM_TOKEN;
+            feeder->lexer = c == '-' ? MINUS_LEX : c == '0' ? ZERO_LEX : INTEGER_LEX;
+            break;
     }
-    token right_brace = next_token(token_stream); // ]
-    if (right_brace.type != RIGHT_BRACE_TOKEN) {
-        return 0;
+    depth_stack *stack = &feeder->stack;
+    switch (*(*(grammar_moves + feeder->state) + type)) {
+        case SCALAR_MOVE:
+            break;
+        case OPEN_ARRAY_MOVE:
+            feeder->state = ARRAY_FIRST_STATE;
+            return push_depth(stack, ARRAY_NEXT_STATE);
+        case OPEN_OBJECT_MOVE:
+            feeder->state = OBJECT_FIRST_STATE;
+            return push_depth(stack, OBJECT_NEXT_STATE);
+        case CLOSE_MOVE:
+            stack->len--;
+            break;
+        case KEY_MOVE:
+            feeder->state = OBJECT_COLON_STATE;
+            return 1;
+        case COLON_MOVE:
+        case ARRAY_COMMA_MOVE:
+            feeder->state = VALUE_STATE;
+            return 1;
+        case OBJECT_COMMA_MOVE:
+            feeder->state = OBJECT_KEY_STATE;
+            return 1;
+        default:
+            return 0;
+    }
+    // A value has started (a scalar) or closed (a container).
+    if (stack->len == 0) {
+        feeder->finished = 1;
+    } else {
+        feeder->state = *(stack->states + stack->len - 1);
     }
     return 1;
 }
 
-int check_object_expression(token_stream *token_stream, int depth) {
-    depth++;
-    if (depth > MAX_DEPTH) {
-        return 0;
+// A number can always go on, so a document that is one is only complete
+// at the end of the input.
+INTERNAL json_status feeder_status(json_feeder *feeder) {
+    if (feeder->failed) {
+        return JSON_INVALID;
     }
-    token left_bracket = next_token(token_stream); // {
-    if (left_bracket.type != LEFT_BRACKET_TOKEN) {
-        return 0;
+    return feeder->finished && feeder->lexer == BETWEEN_LEX ? JSON_COMPLETE : JSON_INCOMPLETE;
+}
+
+json_status json_feed_end(json_feeder *feeder) {
+    uint8_t lexer = feeder->lexer;
+    if (lexer == ZERO_LEX || lexer == INTEGER_LEX || lexer == FRACTION_LEX || lexer == EXPONENT_LEX) {
+        feeder->lexer = BETWEEN_LEX;
     }
-    int res = 1;
-    while (peek_token(token_stream).type != RIGHT_BRACKET_TOKEN) {
-        res = res && check_object_property(token_stream, depth);
-        if (!res) {
-            return 0;
+    feeder->failed |= feeder_status(feeder) != JSON_COMPLETE;
+    return feeder_status(feeder);
+}
+
+void json_feeder_destroy(json_feeder *feeder) {
+    destroy_depth_stack(&feeder->stack);
+    free(feeder);
+}
+
+INTERNAL char is_option(string *arg) {
+    return arg->len > 0 && *(arg->buffer) == '-';
+}
+
+INTERNAL dom create_dom(size_t input_len) {
+    dom dom;
+    dom.alloc = input_len / 8 + 64;
+    dom.words = (uint64_t *)malloc(dom.alloc * sizeof(uint64_t));
+    dom.len = 0;
+    dom.open = SIZE_MAX;
+    return dom;
+}
+
+// Bumps the tape by count words and returns them; the arena doubles when
+// it runs out, which may move it.
+INTERNAL uint64_t *reserve_words(dom *dom, size_t count) {
+    if (dom->len + count > dom->alloc) {
+        while (dom->len + count > dom->alloc) {
+            dom->alloc *= 2;
         }
-        token comma_token = peek_token(token_stream);
-        if (comma_token.type != COMMA_TOKEN && comma_token.type != RIGHT_BRACKET_TOKEN) {
-            return 0;
+        dom->words = (uint64_t *)realloc(dom->words, dom->alloc * sizeof(uint64_t));
+    }
+    uint64_t *words = dom->words + dom->len;
+    dom->len += count;
+    return words;
+}
+
+// Until the container closes, its payload links to the one around it, so
+// no stack of open indexes is needed.
+INTERNAL void append_open(dom *dom, char tag) {
+    size_t index = dom->len;
+    *reserve_words(dom, 1) = (uint64_t)(unsigned char)tag | (uint64_t)dom->open << 8;
+    dom->open = index;
+}
+
+INTERNAL void append_close(dom *dom, char tag) {
+    size_t open = dom->open;
+    size_t index = dom->len;
+    *reserve_words(dom, 1) = (uint64_t)(unsigned char)tag | (uint64_t)open << 8;
+    uint64_t *open_word = dom->words + open;
+    dom->open = *open_word >> 8;
+    *open_word = (*open_word & 0xff) | (uint64_t)(index + 1) << 8;
+}
+
+// Appends a string or key from its raw contents of len bytes, decoding
+// escapes. Decoding never makes a string longer, so the words are reserved
+// for len and the unused ones given back.
+INTERNAL void append_string(dom *dom, char tag, const char *raw, size_t len) {
+    size_t index = dom->len;
+    reserve_words(dom, 1 + (len + 8) / 8);
+    char *bytes = (char *)(dom->words + index + 1);
+    size_t decoded;
+    if (memchr(raw, '\\', len) == NULL) {
+        memcpy(bytes, raw, len);
+        decoded = len;
+    } else {
+        decoded = decode_string(raw, len, bytes);
+    }
+    *(bytes + decoded) = '\0';
+    *(dom->words + index) = (uint64_t)(unsigned char)tag | (uint64_t)decoded << 8;
+    dom->len = index + 1 + (decoded + 8) / 8;
+}
+
+// A number too large for a double ("1e400") is valid JSON, but it would
+// come back out as infinity, which is not; it is rejected instead.
+INTERNAL char append_number(dom *dom, const char *raw, size_t len) {
+    uint64_t *words = reserve_words(dom, 2);
+#ifdef STRTOD_NUMBERS
+    // The conversion parse_number replaced, kept to benchmark against.
+    double real = parse_double_fallback(raw, len);
+    *words = 'd';
+    memcpy(words + 1, &real, sizeof(real));
+    for (size_t i = 0; i < len; i++) {
+        char c = *(raw + i);
+        if (c == '.' || c == 'e' || c == 'E') {
+            return isfinite(real);
         }
-        if (comma_token.type == COMMA_TOKEN) {
-            next_token(token_stream); // ,
-            if (peek_token(token_stream).type == RIGHT_BRACKET_TOKEN) {
-                return 0;
+    }
+    errno = 0;
+    char buffer[NUMBER_BUFFER_SIZE];
+    char *text = len < NUMBER_BUFFER_SIZE ? buffer : (char *)malloc(len + 1);
+    memcpy(text, raw, len);
+    *(text + len) = '\0';
+    int64_t integer = strtoll(text, NULL, 10);
+    if (errno == 0) {
+        *words = 'l';
+        memcpy(words + 1, &integer, sizeof(integer));
+    }
+    if (text != buffer) {
+        free(text);
+    }
+    return *words == 'l' || isfinite(real);
+#else
+    int64_t integer;
+    double real;
+    *words = parse_number(raw, len, &integer, &real);
+    if (*words == 'l') {
+        memcpy(words + 1, &integer, sizeof(integer));
+        return 1;
+    }
+    memcpy(words + 1, &real, sizeof(real));
+    return isfinite(real);
+#endif
+}
+
+// Converts a number the tokenizer has already checked. Integers that fit
+// are kept as int64 ('l'); everything else is the closest double ('d').
+// Digits are taken eight at a time, and the double is computed exactly
+// from the digits and the power of ten without allocating; only numbers
+// with more than 19 significant digits go through strtod.
+INTERNAL char parse_number(const char *raw, size_t len, int64_t *integer, double *real) {
+    const char *end = raw + len;
+    char negative = *raw == '-';
+    const char *digits = raw + negative;
+    uint64_t mantissa = 0;
+    const char *pos = parse_digits(digits, end, &mantissa);
+    size_t digit_count = pos - digits;
+    int64_t exponent = 0;
+    char is_integer = 1;
+    if (pos < end && *pos == '.') {
+        is_integer = 0;
+        const char *fraction = pos + 1;
+        pos = parse_digits(fraction, end, &mantissa);
+        exponent = -(int64_t)(pos - fraction);
+        digit_count += pos - fraction;
+    }
+    if (pos < end) {
+        is_integer = 0;
+        pos++;
+        char exponent_negative = *pos == '-';
+        if (*pos == '-' || *pos == '+') {
+            pos++;
+        }
+        int64_t exponent_value = 0;
+        for (; pos < end; pos++) {
+            // Past this, the result is 0 or infinity anyway.
+            if (exponent_value < 0x10000000) {
+                exponent_value = exponent_value * 10 + (*pos - '0');
             }
         }
+        exponent += exponent_negative ? -exponent_value : exponent_value;
     }
-    if (!res) {
-        return 0;
+    if (digit_count > 19) {
+        // Leading zeros are not significant ("0.000...").
+        for (const char *c = digits; c < end && (*c == '0' || *c == '.'); c++) {
+            digit_count -= *c == '0';
+        }
+        if (digit_count > 19) {
+            *real = parse_double_fallback(raw, len);
+            return 'd';
+        }
     }
-    token right_bracket = next_token(token_stream); // }
-    if (right_bracket.type != RIGHT_BRACKET_TOKEN) {
-        return 0;
+    if (is_integer && mantissa <= (uint64_t)INT64_MAX + negative) {
+        *integer = negative ? (int64_t)(0 - mantissa) : (int64_t)mantissa;
+        return 'l';
+    }
+    *real = compute_double(exponent, mantissa, negative);
+    return 'd';
+}
+
+// Accumulates the digits from pos into *value, returning the first byte
+// that is not a digit.
+INTERNAL const char *parse_digits(const char *pos, const char *end, uint64_t *value) {
+    uint64_t v = *value;
+    while (end - pos >= 8 && is_eight_digits(pos)) {
+        v = v * 100000000 + parse_eight_digits(pos);
+        pos += 8;
+    }
+    while (pos < end && is_numeric(*pos)) {
+        v = v * 10 + (*pos - '0');
+        pos++;
+    }
+    *value = v;
+    return pos;
+}
+
+// Each byte is in '0'..'9' when its high nibble is 3 and adding 6 does not
+// carry into the high nibble.
+INTERNAL char is_eight_digits(const char *chars) {
+    uint64_t value;
+    memcpy(&value, chars, sizeof(value));
+    return (((value & 0xf0f0f0f0f0f0f0f0ULL) | (((value + 0x0606060606060606ULL) & 0xf0f0f0f0f0f0f0f0ULL) >> 4)) == 0x3333333333333333ULL);
+}
+
+// Combines eight ASCII digits into their value in three multiplies: pairs
+// of digits, then pairs of pairs, then the two halves. The first digit is
+// the lowest byte, so this assumes a little-endian load.
+INTERNAL uint32_t parse_eight_digits(const char *chars) {
+    const uint64_t mask = 0x000000ff000000ffULL;
+    const uint64_t mul1 = 0x000f424000000064ULL;
+    const uint64_t mul2 = 0x0000271000000001ULL;
+    uint64_t value;
+    memcpy(&value, chars, sizeof(value));
+    value -= 0x3030303030303030ULL;
+    value = value * 10 + (value >> 8);
+    value = ((value & mask) * mul1 + ((value >> 16) & mask) * mul2) >> 32;
+    return (uint32_t)value;
+}
+
+// 5^q for q in [-342, 308], normalised and truncated to 128 bits, high
+// word first: the table the Eisel-Lemire algorithm multiplies by.
+static const uint64_t powers_of_five[2 * 651] = {
+    0xeef453d6923bd65aULL, 0x113faa2906a13b3fULL,
+    0x9558b4661b6565f8ULL, 0x4ac7ca59a424c507ULL,
+    0xbaaee17fa23ebf76ULL, 0x5d79bcf00d2df649ULL,
+    0xe95a99df8ace6f53ULL, 0xf4d82c2c107973dcULL,
+    0x91d8a02bb6c10594ULL, 0x79071b9b8a4be869ULL,
+    0xb64ec836a47146f9ULL, 0x9748e2826cdee284ULL,
+    0xe3e27a444d8d98b7ULL, 0xfd1b1b2308169b25ULL,
+    0x8e6d8c6ab0787f72ULL, 0xfe30f0f5e50e20f7ULL,
+    0xb208ef855c969f4fULL, 0xbdbd2d335e51a935ULL,
+    0xde8b2b66b3bc4723ULL, 0xad2c788035e61382ULL,
+    0x8b16fb203055ac76ULL, 0x4c3bcb5021afcc31ULL,
+    0xaddcb9e83c6b1793ULL, 0xdf4abe242a1bbf3dULL,
+    0xd953e8624b85dd78ULL, 0xd71d6dad34a2af0dULL,
+    0x87d4713d6f33aa6bULL, 0x8672648c40e5ad68ULL,
+    0xa9c98d8ccb009506ULL, 0x680efdaf511f18c2ULL,
+    0xd43bf0effdc0ba48ULL, 0x0212bd1b2566def2ULL,
+    0x84a57695fe98746dULL, 0x014bb630f7604b57ULL,
+    0xa5ced43b7e3e9188ULL, 0x419ea3bd35385e2dULL,
+    0xcf42894a5dce35eaULL, 0x52064cac828675b9ULL,
+    0x818995ce7aa0e1b2ULL, 0x7343efebd1940993ULL,
+    0xa1ebfb4219491a1fULL, 0x1014ebe6c5f90bf8ULL,
+    0xca66fa129f9b60a6ULL, 0xd41a26e077774ef6ULL,
+    0xfd00b897478238d0ULL, 0x8920b098955522b4ULL,
+    0x9e20735e8cb16382ULL, 0x55b46e5f5d5535b0ULL,
+    0xc5a890362fddbc62ULL, 0xeb2189f734aa831dULL,
+    0xf712b443bbd52b7bULL, 0xa5e9ec7501d523e4ULL,
+    0x9a6bb0aa55653b2dULL, 0x47b233c92125366eULL,
+    0xc1069cd4eabe89f8ULL, 0x999ec0bb696e840aULL,
+    0xf148440a256e2c76ULL, 0xc00670ea43ca250dULL,
+    0x96cd2a865764dbcaULL, 0x380406926a5e5728ULL,
+    0xbc807527ed3e12bcULL, 0xc605083704f5ecf2ULL,
+    0xeba09271e88d976bULL, 0xf7864a44c633682eULL,
+    0x93445b8731587ea3ULL, 0x7ab3ee6afbe0211dULL,
+    0xb8157268fdae9e4cULL, 0x5960ea05bad82964ULL,
+    0xe61acf033d1a45dfULL, 0x6fb92487298e33bdULL,
+    0x8fd0c16206306babULL, 0xa5d3b6d479f8e056ULL,
+    0xb3c4f1ba87bc8696ULL, 0x8f48a4899877186cULL,
+    0xe0b62e2929aba83cULL, 0x331acdabfe94de87ULL,
+    0x8c71dcd9ba0b4925ULL, 0x9ff0c08b7f1d0b14ULL,
+    0xaf8e5410288e1b6fULL, 0x07ecf0ae5ee44dd9ULL,
+    0xdb71e91432b1a24aULL, 0xc9e82cd9f69d6150ULL,
+    0x892731ac9faf056eULL, 0xbe311c083a225cd2ULL,
+    0xab70fe17c79ac6caULL, 0x6dbd630a48aaf406ULL,
+    0xd64d3d9db981787dULL, 0x092cbbccdad5b108ULL,
+    0x85f0468293f0eb4eULL, 0x25bbf56008c58ea5ULL,
+    0xa76c582338ed2621ULL, 0xaf2af2b80af6f24eULL,
+    0xd1476e2c07286faaULL, 0x1af5af660db4aee1ULL,
+    0x82cca4db847945caULL, 0x50d98d9fc890ed4dULL,
+    0xa37fce126597973cULL, 0xe50ff107bab528a0ULL,
+    0xcc5fc196fefd7d0cULL, 0x1e53ed49a96272c8ULL,
+    0xff77b1fcbebcdc4fULL, 0x25e8e89c13bb0f7aULL,
+    0x9faacf3df73609b1ULL, 0x77b191618c54e9acULL,
+    0xc795830d75038c1dULL, 0xd59df5b9ef6a2417ULL,
+    0xf97ae3d0d2446f25ULL, 0x4b0573286b44ad1dULL,
+    0x9becce62836ac577ULL, 0x4ee367f9430aec32ULL,
+    0xc2e801fb244576d5ULL, 0x229c41f793cda73fULL,
+    0xf3a20279ed56d48aULL, 0x6b43527578c1110fULL,
+    0x9845418c345644d6ULL, 0x830a13896b78aaa9ULL,
+    0xbe5691ef416bd60cULL, 0x23cc986bc656d553ULL,
+    0xedec366b11c6cb8fULL, 0x2cbfbe86b7ec8aa8ULL,
+    0x94b3a202eb1c3f39ULL, 0x7bf7d71432f3d6a9ULL,
+    0xb9e08a83a5e34f07ULL, 0xdaf5ccd93fb0cc53ULL,
+    0xe858ad248f5c22c9ULL, 0xd1b3400f8f9cff68ULL,
+    0x91376c36d99995beULL, 0x23100809b9c21fa1ULL,
+    0xb58547448ffffb2dULL, 0xabd40a0c2832a78aULL,
+    0xe2e69915b3fff9f9ULL, 0x16c90c8f323f516cULL,
+    0x8dd01fad907ffc3bULL, 0xae3da7d97f6792e3ULL,
+    0xb1442798f49ffb4aULL, 0x99cd11cfdf41779cULL,
+    0xdd95317f31c7fa1dULL, 0x40405643d711d583ULL,
+    0x8a7d3eef7f1cfc52ULL, 0x482835ea666b2572ULL,
+    0xad1c8eab5ee43b66ULL, 0xda3243650005eecfULL,
+    0xd863b256369d4a40ULL, 0x90bed43e40076a82ULL,
+    0x873e4f75e2224e68ULL, 0x5a7744a6e804a291ULL,
+    0xa90de3535aaae202ULL, 0x711515d0a205cb36ULL,
+    0xd3515c2831559a83ULL, 0x0d5a5b44ca873e03ULL,
+    0x8412d9991ed58091ULL, 0xe858790afe9486c2ULL,
+    0xa5178fff668ae0b6ULL, 0x626e974dbe39a872ULL,
+    0xce5d73ff402d98e3ULL, 0xfb0a3d212dc8128fULL,
+    0x80fa687f881c7f8eULL, 0x7ce66634bc9d0b99ULL,
+    0xa139029f6a239f72ULL, 0x1c1fffc1ebc44e80ULL,
+    0xc987434744ac874eULL, 0xa327ffb266b56220ULL,
+    0xfbe9141915d7a922ULL, 0x4bf1ff9f0062baa8ULL,
+    0x9d71ac8fada6c9b5ULL, 0x6f773fc3603db4a9ULL,
+    0xc4ce17b399107c22ULL, 0xcb550fb4384d21d3ULL,
+    0xf6019da07f549b2bULL, 0x7e2a53a146606a48ULL,
+    0x99c102844f94e0fbULL, 0x2eda7444cbfc426dULL,
+    0xc0314325637a1939ULL, 0xfa911155fefb5308ULL,
+    0xf03d93eebc589f88ULL, 0x793555ab7eba27caULL,
+    0x96267c7535b763b5ULL, 0x4bc1558b2f3458deULL,
+    0xbbb01b9283253ca2ULL, 0x9eb1aaedfb016f16ULL,
+    0xea9c227723ee8bcbULL, 0x465e15a979c1cadcULL,
+    0x92a1958a7675175fULL, 0x0bfacd89ec191ec9ULL,
+    0xb749faed14125d36ULL, 0xcef980ec671f667bULL,
+    0xe51c79a85916f484ULL, 0x82b7e12780e7401aULL,
+    0x8f31cc0937ae58d2ULL, 0xd1b2ecb8b0908810ULL,
+    0xb2fe3f0b8599ef07ULL, 0x861fa7e6dcb4aa15ULL,
+    0xdfbdcece67006ac9ULL, 0x67a791e093e1d49aULL,
+    0x8bd6a141006042bdULL, 0xe0c8bb2c5c6d24e0ULL,
+    0xaecc49914078536dULL, 0x58fae9f773886e18ULL,
+    0xda7f5bf590966848ULL, 0xaf39a475506a899eULL,
+    0x888f99797a5e012dULL, 0x6d8406c952429603ULL,
+    0xaab37fd7d8f58178ULL, 0xc8e5087ba6d33b83ULL,
+    0xd5605fcdcf32e1d6ULL, 0xfb1e4a9a90880a64ULL,
+    0x855c3be0a17fcd26ULL, 0x5cf2eea09a55067fULL,
+    0xa6b34ad8c9dfc06fULL, 0xf42faa48c0ea481eULL,
+    0xd0601d8efc57b08bULL, 0xf13b94daf124da26ULL,
+    0x823c12795db6ce57ULL, 0x76c53d08d6b70858ULL,
+    0xa2cb1717b52481edULL, 0x54768c4b0c64ca6eULL,
+    0xcb7ddcdda26da268ULL, 0xa9942f5dcf7dfd09ULL,
+    0xfe5d54150b090b02ULL, 0xd3f93b35435d7c4cULL,
+    0x9efa548d26e5a6e1ULL, 0xc47bc5014a1a6dafULL,
+    0xc6b8e9b0709f109aULL, 0x359ab6419ca1091bULL,
+    0xf867241c8cc6d4c0ULL, 0xc30163d203c94b62ULL,
+    0x9b407691d7fc44f8ULL, 0x79e0de63425dcf1dULL,
+    0xc21094364dfb5636ULL, 0x985915fc12f542e4ULL,
+    0xf294b943e17a2bc4ULL, 0x3e6f5b7b17b2939dULL,
+    0x979cf3ca6cec5b5aULL, 0xa705992ceecf9c42ULL,
+    0xbd8430bd08277231ULL, 0x50c6ff782a838353ULL,
+    0xece53cec4a314ebdULL, 0xa4f8bf5635246428ULL,
+    0x940f4613ae5ed136ULL, 0x871b7795e136be99ULL,
+    0xb913179899f68584ULL, 0x28e2557b59846e3fULL,
+    0xe757dd7ec07426e5ULL, 0x331aeada2fe589cfULL,
+    0x9096ea6f3848984fULL, 0x3ff0d2c85def7621ULL,
+    0xb4bca50b065abe63ULL, 0x0fed077a756b53a9ULL,
+    0xe1ebce4dc7f16dfbULL, 0xd3e8495912c62894ULL,
+    0x8d3360f09cf6e4bdULL, 0x64712dd7abbbd95cULL,
+    0xb080392cc4349decULL, 0xbd8d794d96aacfb3ULL,
+    0xdca04777f541c567ULL, 0xecf0d7a0fc5583a0ULL,
+    0x89e42caaf9491b60ULL, 0xf41686c49db57244ULL,
+    0xac5d37d5b79b6239ULL, 0x311c2875c522ced5ULL,
+    0xd77485cb25823ac7ULL, 0x7d633293366b828bULL,
+    0x86a8d39ef77164bcULL, 0xae5dff9c02033197ULL,
+    0xa8530886b54dbdebULL, 0xd9f57f830283fdfcULL,
+    0xd267caa862a12d66ULL, 0xd072df63c324fd7bULL,
+    0x8380dea93da4bc60ULL, 0x4247cb9e59f71e6dULL,
+    0xa46116538d0deb78ULL, 0x52d9be85f074e608ULL,
+    0xcd795be870516656ULL, 0x67902e276c921f8bULL,
+    0x806bd9714632dff6ULL, 0x00ba1cd8a3db53b6ULL,
+    0xa086cfcd97bf97f3ULL, 0x80e8a40eccd228a4ULL,
+    0xc8a883c0fdaf7df0ULL, 0x6122cd128006b2cdULL,
+    0xfad2a4b13d1b5d6cULL, 0x796b805720085f81ULL,
+    0x9cc3a6eec6311a63ULL, 0xcbe3303674053bb0ULL,
+    0xc3f490aa77bd60fcULL, 0xbedbfc4411068a9cULL,
+    0xf4f1b4d515acb93bULL, 0xee92fb5515482d44ULL,
+    0x991711052d8bf3c5ULL, 0x751bdd152d4d1c4aULL,
+    0xbf5cd54678eef0b6ULL, 0xd262d45a78a0635dULL,
+    0xef340a98172aace4ULL, 0x86fb897116c87c34ULL,
+    0x9580869f0e7aac0eULL, 0xd45d35e6ae3d4da0ULL,
+    0xbae0a846d2195712ULL, 0x8974836059cca109ULL,
+    0xe998d258869facd7ULL, 0x2bd1a438703fc94bULL,
+    0x91ff83775423cc06ULL, 0x7b6306a34627ddcfULL,
+    0xb67f6455292cbf08ULL, 0x1a3bc84c17b1d542ULL,
+    0xe41f3d6a7377eecaULL, 0x20caba5f1d9e4a93ULL,
+    0x8e938662882af53eULL, 0x547eb47b7282ee9cULL,
+    0xb23867fb2a35b28dULL, 0xe99e619a4f23aa43ULL,
+    0xdec681f9f4c31f31ULL, 0x6405fa00e2ec94d4ULL,
+    0x8b3c113c38f9f37eULL, 0xde83bc408dd3dd04ULL,
+    0xae0b158b4738705eULL, 0x9624ab50b148d445ULL,
+    0xd98ddaee19068c76ULL, 0x3badd624dd9b0957ULL,
+    0x87f8a8d4cfa417c9ULL, 0xe54ca5d70a80e5d6ULL,
+    0xa9f6d30a038d1dbcULL, 0x5e9fcf4ccd211f4cULL,
+    0xd47487cc8470652bULL, 0x7647c3200069671fULL,
+    0x84c8d4dfd2c63f3bULL, 0x29ecd9f40041e073ULL,
+    0xa5fb0a17c777cf09ULL, 0xf468107100525890ULL,
+    0xcf79cc9db955c2ccULL, 0x7182148d4066eeb4ULL,
+    0x81ac1fe293d599bfULL, 0xc6f14cd848405530ULL,
+    0xa21727db38cb002fULL, 0xb8ada00e5a506a7cULL,
+    0xca9cf1d206fdc03bULL, 0xa6d90811f0e4851cULL,
+    0xfd442e4688bd304aULL, 0x908f4a166d1da663ULL,
+    0x9e4a9cec15763e2eULL, 0x9a598e4e043287feULL,
+    0xc5dd44271ad3cdbaULL, 0x40eff1e1853f29fdULL,
+    0xf7549530e188c128ULL, 0xd12bee59e68ef47cULL,
+    0x9a94dd3e8cf578b9ULL, 0x82bb74f8301958ceULL,
+    0xc13a148e3032d6e7ULL, 0xe36a52363c1faf01ULL,
+    0xf18899b1bc3f8ca1ULL, 0xdc44e6c3cb279ac1ULL,
+    0x96f5600f15a7b7e5ULL, 0x29ab103a5ef8c0b9ULL,
+    0xbcb2b812db11a5deULL, 0x7415d448f6b6f0e7ULL,
+    0xebdf661791d60f56ULL, 0x111b495b3464ad21ULL,
+    0x936b9fcebb25c995ULL, 0xcab10dd900beec34ULL,
+    0xb84687c269ef3bfbULL, 0x3d5d514f40eea742ULL,
+    0xe65829b3046b0afaULL, 0x0cb4a5a3112a5112ULL,
+    0x8ff71a0fe2c2e6dcULL, 0x47f0e785eaba72abULL,
+    0xb3f4e093db73a093ULL, 0x59ed216765690f56ULL,
+    0xe0f218b8d25088b8ULL, 0x306869c13ec3532cULL,
+    0x8c974f7383725573ULL, 0x1e414218c73a13fbULL,
+    0xafbd2350644eeacfULL, 0xe5d1929ef90898faULL,
+    0xdbac6c247d62a583ULL, 0xdf45f746b74abf39ULL,
+    0x894bc396ce5da772ULL, 0x6b8bba8c328eb783ULL,
+    0xab9eb47c81f5114fULL, 0x066ea92f3f326564ULL,
+    0xd686619ba27255a2ULL, 0xc80a537b0efefebdULL,
+    0x8613fd0145877585ULL, 0xbd06742ce95f5f36ULL,
+    0xa798fc4196e952e7ULL, 0x2c48113823b73704ULL,
+    0xd17f3b51fca3a7a0ULL, 0xf75a15862ca504c5ULL,
+    0x82ef85133de648c4ULL, 0x9a984d73dbe722fbULL,
+    0xa3ab66580d5fdaf5ULL, 0xc13e60d0d2e0ebbaULL,
+    0xcc963fee10b7d1b3ULL, 0x318df905079926a8ULL,
+    0xffbbcfe994e5c61fULL, 0xfdf17746497f7052ULL,
+    0x9fd561f1fd0f9bd3ULL, 0xfeb6ea8bedefa633ULL,
+    0xc7caba6e7c5382c8ULL, 0xfe64a52ee96b8fc0ULL,
+    0xf9bd690a1b68637bULL, 0x3dfdce7aa3c673b0ULL,
+    0x9c1661a651213e2dULL, 0x06bea10ca65c084eULL,
+    0xc31bfa0fe5698db8ULL, 0x486e494fcff30a62ULL,
+    0xf3e2f893dec3f126ULL, 0x5a89dba3c3efccfaULL,
+    0x986ddb5c6b3a76b7ULL, 0xf89629465a75e01cULL,
+    0xbe89523386091465ULL, 0xf6bbb397f1135823ULL,
+    0xee2ba6c0678b597fULL, 0x746aa07ded582e2cULL,
+    0x94db483840b717efULL, 0xa8c2a44eb4571cdcULL,
+    0xba121a4650e4ddebULL, 0x92f34d62616ce413ULL,
+    0xe896a0d7e51e1566ULL, 0x77b020baf9c81d17ULL,
+    0x915e2486ef32cd60ULL, 0x0ace1474dc1d122eULL,
+    0xb5b5ada8aaff80b8ULL, 0x0d819992132456baULL,
+    0xe3231912d5bf60e6ULL, 0x10e1fff697ed6c69ULL,
+    0x8df5efabc5979c8fULL, 0xca8d3ffa1ef463c1ULL,
+    0xb1736b96b6fd83b3ULL, 0xbd308ff8a6b17cb2ULL,
+    0xddd0467c64bce4a0ULL, 0xac7cb3f6d05ddbdeULL,
+    0x8aa22c0dbef60ee4ULL, 0x6bcdf07a423aa96bULL,
+    0xad4ab7112eb3929dULL, 0x86c16c98d2c953c6ULL,
+    0xd89d64d57a607744ULL, 0xe871c7bf077ba8b7ULL,
+    0x87625f056c7c4a8bULL, 0x11471cd764ad4972ULL,
+    0xa93af6c6c79b5d2dULL, 0xd598e40d3dd89bcfULL,
+    0xd389b47879823479ULL, 0x4aff1d108d4ec2c3ULL,
+    0x843610cb4bf160cbULL, 0xcedf722a585139baULL,
+    0xa54394fe1eedb8feULL, 0xc2974eb4ee658828ULL,
+    0xce947a3da6a9273eULL, 0x733d226229feea32ULL,
+    0x811ccc668829b887ULL, 0x0806357d5a3f525fULL,
+    0xa163ff802a3426a8ULL, 0xca07c2dcb0cf26f7ULL,
+    0xc9bcff6034c13052ULL, 0xfc89b393dd02f0b5ULL,
+    0xfc2c3f3841f17c67ULL, 0xbbac2078d443ace2ULL,
+    0x9d9ba7832936edc0ULL, 0xd54b944b84aa4c0dULL,
+    0xc5029163f384a931ULL, 0x0a9e795e65d4df11ULL,
+    0xf64335bcf065d37dULL, 0x4d4617b5ff4a16d5ULL,
+    0x99ea0196163fa42eULL, 0x504bced1bf8e4e45ULL,
+    0xc06481fb9bcf8d39ULL, 0xe45ec2862f71e1d6ULL,
+    0xf07da27a82c37088ULL, 0x5d767327bb4e5a4cULL,
+    0x964e858c91ba2655ULL, 0x3a6a07f8d510f86fULL,
+    0xbbe226efb628afeaULL, 0x890489f70a55368bULL,
+    0xeadab0aba3b2dbe5ULL, 0x2b45ac74ccea842eULL,
+    0x92c8ae6b464fc96fULL, 0x3b0b8bc90012929dULL,
+    0xb77ada0617e3bbcbULL, 0x09ce6ebb40173744ULL,
+    0xe55990879ddcaabdULL, 0xcc420a6a101d0515ULL,
+    0x8f57fa54c2a9eab6ULL, 0x9fa946824a12232dULL,
+    0xb32df8e9f3546564ULL, 0x47939822dc96abf9ULL,
+    0xdff9772470297ebdULL, 0x59787e2b93bc56f7ULL,
+    0x8bfbea76c619ef36ULL, 0x57eb4edb3c55b65aULL,
+    0xaefae51477a06b03ULL, 0xede622920b6b23f1ULL,
+    0xdab99e59958885c4ULL, 0xe95fab368e45ecedULL,
+    0x88b402f7fd75539bULL, 0x11dbcb0218ebb414ULL,
+    0xaae103b5fcd2a881ULL, 0xd652bdc29f26a119ULL,
+    0xd59944a37c0752a2ULL, 0x4be76d3346f0495fULL,
+    0x857fcae62d8493a5ULL, 0x6f70a4400c562ddbULL,
+    0xa6dfbd9fb8e5b88eULL, 0xcb4ccd500f6bb952ULL,
+    0xd097ad07a71f26b2ULL, 0x7e2000a41346a7a7ULL,
+    0x825ecc24c873782fULL, 0x8ed400668c0c28c8ULL,
+    0xa2f67f2dfa90563bULL, 0x728900802f0f32faULL,
+    0xcbb41ef979346bcaULL, 0x4f2b40a03ad2ffb9ULL,
+    0xfea126b7d78186bcULL, 0xe2f610c84987bfa8ULL,
+    0x9f24b832e6b0f436ULL, 0x0dd9ca7d2df4d7c9ULL,
+    0xc6ede63fa05d3143ULL, 0x91503d1c79720dbbULL,
+    0xf8a95fcf88747d94ULL, 0x75a44c6397ce912aULL,
+    0x9b69dbe1b548ce7cULL, 0xc986afbe3ee11abaULL,
+    0xc24452da229b021bULL, 0xfbe85badce996168ULL,
+    0xf2d56790ab41c2a2ULL, 0xfae27299423fb9c3ULL,
+    0x97c560ba6b0919a5ULL, 0xdccd879fc967d41aULL,
+    0xbdb6b8e905cb600fULL, 0x5400e987bbc1c920ULL,
+    0xed246723473e3813ULL, 0x290123e9aab23b68ULL,
+    0x9436c0760c86e30bULL, 0xf9a0b6720aaf6521ULL,
+    0xb94470938fa89bceULL, 0xf808e40e8d5b3e69ULL,
+    0xe7958cb87392c2c2ULL, 0xb60b1d1230b20e04ULL,
+    0x90bd77f3483bb9b9ULL, 0xb1c6f22b5e6f48c2ULL,
+    0xb4ecd5f01a4aa828ULL, 0x1e38aeb6360b1af3ULL,
+    0xe2280b6c20dd5232ULL, 0x25c6da63c38de1b0ULL,
+    0x8d590723948a535fULL, 0x579c487e5a38ad0eULL,
+    0xb0af48ec79ace837ULL, 0x2d835a9df0c6d851ULL,
+    0xdcdb1b2798182244ULL, 0xf8e431456cf88e65ULL,
+    0x8a08f0f8bf0f156bULL, 0x1b8e9ecb641b58ffULL,
+    0xac8b2d36eed2dac5ULL, 0xe272467e3d222f3fULL,
+    0xd7adf884aa879177ULL, 0x5b0ed81dcc6abb0fULL,
+    0x86ccbb52ea94baeaULL, 0x98e947129fc2b4e9ULL,
+    0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL,
+    0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL,
+    0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL,
+    0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL,
+    0xcdb02555653131b6ULL, 0x3792f412cb06794dULL,
+    0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL,
+    0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL,
+    0xc8de047564d20a8bULL, 0xf245825a5a445275ULL,
+    0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL,
+    0x9ced737bb6c4183dULL, 0x55464dd69685606bULL,
+    0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL,
+    0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL,
+    0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL,
+    0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL,
+    0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL,
+    0x95a8637627989aadULL, 0xdde7001379a44aa8ULL,
+    0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL,
+    0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL,
+    0x9226712162ab070dULL, 0xcab3961304ca70e8ULL,
+    0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL,
+    0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL,
+    0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL,
+    0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL,
+    0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL,
+    0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL,
+    0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL,
+    0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL,
+    0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL,
+    0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL,
+    0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL,
+    0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL,
+    0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL,
+    0xcfb11ead453994baULL, 0x67de18eda5814af2ULL,
+    0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL,
+    0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL,
+    0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL,
+    0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL,
+    0x9e74d1b791e07e48ULL, 0x775ea264cf55347eULL,
+    0xc612062576589ddaULL, 0x95364afe032a819eULL,
+    0xf79687aed3eec551ULL, 0x3a83ddbd83f52205ULL,
+    0x9abe14cd44753b52ULL, 0xc4926a9672793543ULL,
+    0xc16d9a0095928a27ULL, 0x75b7053c0f178294ULL,
+    0xf1c90080baf72cb1ULL, 0x5324c68b12dd6339ULL,
+    0x971da05074da7beeULL, 0xd3f6fc16ebca5e04ULL,
+    0xbce5086492111aeaULL, 0x88f4bb1ca6bcf585ULL,
+    0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e6ULL,
+    0x9392ee8e921d5d07ULL, 0x3aff322e62439fd0ULL,
+    0xb877aa3236a4b449ULL, 0x09befeb9fad487c3ULL,
+    0xe69594bec44de15bULL, 0x4c2ebe687989a9b4ULL,
+    0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a11ULL,
+    0xb424dc35095cd80fULL, 0x538484c19ef38c95ULL,
+    0xe12e13424bb40e13ULL, 0x2865a5f206b06fbaULL,
+    0x8cbccc096f5088cbULL, 0xf93f87b7442e45d4ULL,
+    0xafebff0bcb24aafeULL, 0xf78f69a51539d749ULL,
+    0xdbe6fecebdedd5beULL, 0xb573440e5a884d1cULL,
+    0x89705f4136b4a597ULL, 0x31680a88f8953031ULL,
+    0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3eULL,
+    0xd6bf94d5e57a42bcULL, 0x3d32907604691b4dULL,
+    0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b110ULL,
+    0xa7c5ac471b478423ULL, 0x0fcf80dc33721d54ULL,
+    0xd1b71758e219652bULL, 0xd3c36113404ea4a9ULL,
+    0x83126e978d4fdf3bULL, 0x645a1cac083126eaULL,
+    0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a4ULL,
+    0xccccccccccccccccULL, 0xcccccccccccccccdULL,
+    0x8000000000000000ULL, 0x0000000000000000ULL,
+    0xa000000000000000ULL, 0x0000000000000000ULL,
+    0xc800000000000000ULL, 0x0000000000000000ULL,
+    0xfa00000000000000ULL, 0x0000000000000000ULL,
+    0x9c40000000000000ULL, 0x0000000000000000ULL,
+    0xc350000000000000ULL, 0x0000000000000000ULL,
+    0xf424000000000000ULL, 0x0000000000000000ULL,
+    0x9896800000000000ULL, 0x0000000000000000ULL,
+    0xbebc200000000000ULL, 0x0000000000000000ULL,
+    0xee6b280000000000ULL, 0x0000000000000000ULL,
+    0x9502f90000000000ULL, 0x0000000000000000ULL,
+    0xba43b74000000000ULL, 0x0000000000000000ULL,
+    0xe8d4a51000000000ULL, 0x0000000000000000ULL,
+    0x9184e72a00000000ULL, 0x0000000000000000ULL,
+    0xb5e620f480000000ULL, 0x0000000000000000ULL,
+    0xe35fa931a0000000ULL, 0x0000000000000000ULL,
+    0x8e1bc9bf04000000ULL, 0x0000000000000000ULL,
+    0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL,
+    0xde0b6b3a76400000ULL, 0x0000000000000000ULL,
+    0x8ac7230489e80000ULL, 0x0000000000000000ULL,
+    0xad78ebc5ac620000ULL, 0x0000000000000000ULL,
+    0xd8d726b7177a8000ULL, 0x0000000000000000ULL,
+    0x878678326eac9000ULL, 0x0000000000000000ULL,
+    0xa968163f0a57b400ULL, 0x0000000000000000ULL,
+    0xd3c21bcecceda100ULL, 0x0000000000000000ULL,
+    0x84595161401484a0ULL, 0x0000000000000000ULL,
+    0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL,
+    0xcecb8f27f4200f3aULL, 0x0000000000000000ULL,
+    0x813f3978f8940984ULL, 0x4000000000000000ULL,
+    0xa18f07d736b90be5ULL, 0x5000000000000000ULL,
+    0xc9f2c9cd04674edeULL, 0xa400000000000000ULL,
+    0xfc6f7c4045812296ULL, 0x4d00000000000000ULL,
+    0x9dc5ada82b70b59dULL, 0xf020000000000000ULL,
+    0xc5371912364ce305ULL, 0x6c28000000000000ULL,
+    0xf684df56c3e01bc6ULL, 0xc732000000000000ULL,
+    0x9a130b963a6c115cULL, 0x3c7f400000000000ULL,
+    0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL,
+    0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL,
+    0x96769950b50d88f4ULL, 0x1314448000000000ULL,
+    0xbc143fa4e250eb31ULL, 0x17d955a000000000ULL,
+    0xeb194f8e1ae525fdULL, 0x5dcfab0800000000ULL,
+    0x92efd1b8d0cf37beULL, 0x5aa1cae500000000ULL,
+    0xb7abc627050305adULL, 0xf14a3d9e40000000ULL,
+    0xe596b7b0c643c719ULL, 0x6d9ccd05d0000000ULL,
+    0x8f7e32ce7bea5c6fULL, 0xe4820023a2000000ULL,
+    0xb35dbf821ae4f38bULL, 0xdda2802c8a800000ULL,
+    0xe0352f62a19e306eULL, 0xd50b2037ad200000ULL,
+    0x8c213d9da502de45ULL, 0x4526f422cc340000ULL,
+    0xaf298d050e4395d6ULL, 0x9670b12b7f410000ULL,
+    0xdaf3f04651d47b4cULL, 0x3c0cdd765f114000ULL,
+    0x88d8762bf324cd0fULL, 0xa5880a69fb6ac800ULL,
+    0xab0e93b6efee0053ULL, 0x8eea0d047a457a00ULL,
+    0xd5d238a4abe98068ULL, 0x72a4904598d6d880ULL,
+    0x85a36366eb71f041ULL, 0x47a6da2b7f864750ULL,
+    0xa70c3c40a64e6c51ULL, 0x999090b65f67d924ULL,
+    0xd0cf4b50cfe20765ULL, 0xfff4b4e3f741cf6dULL,
+    0x82818f1281ed449fULL, 0xbff8f10e7a8921a4ULL,
+    0xa321f2d7226895c7ULL, 0xaff72d52192b6a0dULL,
+    0xcbea6f8ceb02bb39ULL, 0x9bf4f8a69f764490ULL,
+    0xfee50b7025c36a08ULL, 0x02f236d04753d5b4ULL,
+    0x9f4f2726179a2245ULL, 0x01d762422c946590ULL,
+    0xc722f0ef9d80aad6ULL, 0x424d3ad2b7b97ef5ULL,
+    0xf8ebad2b84e0d58bULL, 0xd2e0898765a7deb2ULL,
+    0x9b934c3b330c8577ULL, 0x63cc55f49f88eb2fULL,
+    0xc2781f49ffcfa6d5ULL, 0x3cbf6b71c76b25fbULL,
+    0xf316271c7fc3908aULL, 0x8bef464e3945ef7aULL,
+    0x97edd871cfda3a56ULL, 0x97758bf0e3cbb5acULL,
+    0xbde94e8e43d0c8ecULL, 0x3d52eeed1cbea317ULL,
+    0xed63a231d4c4fb27ULL, 0x4ca7aaa863ee4bddULL,
+    0x945e455f24fb1cf8ULL, 0x8fe8caa93e74ef6aULL,
+    0xb975d6b6ee39e436ULL, 0xb3e2fd538e122b44ULL,
+    0xe7d34c64a9c85d44ULL, 0x60dbbca87196b616ULL,
+    0x90e40fbeea1d3a4aULL, 0xbc8955e946fe31cdULL,
+    0xb51d13aea4a488ddULL, 0x6babab6398bdbe41ULL,
+    0xe264589a4dcdab14ULL, 0xc696963c7eed2dd1ULL,
+    0x8d7eb76070a08aecULL, 0xfc1e1de5cf543ca2ULL,
+    0xb0de65388cc8ada8ULL, 0x3b25a55f43294bcbULL,
+    0xdd15fe86affad912ULL, 0x49ef0eb713f39ebeULL,
+    0x8a2dbf142dfcc7abULL, 0x6e3569326c784337ULL,
+    0xacb92ed9397bf996ULL, 0x49c2c37f07965404ULL,
+    0xd7e77a8f87daf7fbULL, 0xdc33745ec97be906ULL,
+    0x86f0ac99b4e8dafdULL, 0x69a028bb3ded71a3ULL,
+    0xa8acd7c0222311bcULL, 0xc40832ea0d68ce0cULL,
+    0xd2d80db02aabd62bULL, 0xf50a3fa490c30190ULL,
+    0x83c7088e1aab65dbULL, 0x792667c6da79e0faULL,
+    0xa4b8cab1a1563f52ULL, 0x577001b891185938ULL,
+    0xcde6fd5e09abcf26ULL, 0xed4c0226b55e6f86ULL,
+    0x80b05e5ac60b6178ULL, 0x544f8158315b05b4ULL,
+    0xa0dc75f1778e39d6ULL, 0x696361ae3db1c721ULL,
+    0xc913936dd571c84cULL, 0x03bc3a19cd1e38e9ULL,
+    0xfb5878494ace3a5fULL, 0x04ab48a04065c723ULL,
+    0x9d174b2dcec0e47bULL, 0x62eb0d64283f9c76ULL,
+    0xc45d1df942711d9aULL, 0x3ba5d0bd324f8394ULL,
+    0xf5746577930d6500ULL, 0xca8f44ec7ee36479ULL,
+    0x9968bf6abbe85f20ULL, 0x7e998b13cf4e1ecbULL,
+    0xbfc2ef456ae276e8ULL, 0x9e3fedd8c321a67eULL,
+    0xefb3ab16c59b14a2ULL, 0xc5cfe94ef3ea101eULL,
+    0x95d04aee3b80ece5ULL, 0xbba1f1d158724a12ULL,
+    0xbb445da9ca61281fULL, 0x2a8a6e45ae8edc97ULL,
+    0xea1575143cf97226ULL, 0xf52d09d71a3293bdULL,
+    0x924d692ca61be758ULL, 0x593c2626705f9c56ULL,
+    0xb6e0c377cfa2e12eULL, 0x6f8b2fb00c77836cULL,
+    0xe498f455c38b997aULL, 0x0b6dfb9c0f956447ULL,
+    0x8edf98b59a373fecULL, 0x4724bd4189bd5eacULL,
+    0xb2977ee300c50fe7ULL, 0x58edec91ec2cb657ULL,
+    0xdf3d5e9bc0f653e1ULL, 0x2f2967b66737e3edULL,
+    0x8b865b215899f46cULL, 0xbd79e0d20082ee74ULL,
+    0xae67f1e9aec07187ULL, 0xecd8590680a3aa11ULL,
+    0xda01ee641a708de9ULL, 0xe80e6f4820cc9495ULL,
+    0x884134fe908658b2ULL, 0x3109058d147fdcddULL,
+    0xaa51823e34a7eedeULL, 0xbd4b46f0599fd415ULL,
+    0xd4e5e2cdc1d1ea96ULL, 0x6c9e18ac7007c91aULL,
+    0x850fadc09923329eULL, 0x03e2cf6bc604ddb0ULL,
+    0xa6539930bf6bff45ULL, 0x84db8346b786151cULL,
+    0xcfe87f7cef46ff16ULL, 0xe612641865679a63ULL,
+    0x81f14fae158c5f6eULL, 0x4fcb7e8f3f60c07eULL,
+    0xa26da3999aef7749ULL, 0xe3be5e330f38f09dULL,
+    0xcb090c8001ab551cULL, 0x5cadf5bfd3072cc5ULL,
+    0xfdcb4fa002162a63ULL, 0x73d9732fc7c8f7f6ULL,
+    0x9e9f11c4014dda7eULL, 0x2867e7fddcdd9afaULL,
+    0xc646d63501a1511dULL, 0xb281e1fd541501b8ULL,
+    0xf7d88bc24209a565ULL, 0x1f225a7ca91a4226ULL,
+    0x9ae757596946075fULL, 0x3375788de9b06958ULL,
+    0xc1a12d2fc3978937ULL, 0x0052d6b1641c83aeULL,
+    0xf209787bb47d6b84ULL, 0xc0678c5dbd23a49aULL,
+    0x9745eb4d50ce6332ULL, 0xf840b7ba963646e0ULL,
+    0xbd176620a501fbffULL, 0xb650e5a93bc3d898ULL,
+    0xec5d3fa8ce427affULL, 0xa3e51f138ab4cebeULL,
+    0x93ba47c980e98cdfULL, 0xc66f336c36b10137ULL,
+    0xb8a8d9bbe123f017ULL, 0xb80b0047445d4184ULL,
+    0xe6d3102ad96cec1dULL, 0xa60dc059157491e5ULL,
+    0x9043ea1ac7e41392ULL, 0x87c89837ad68db2fULL,
+    0xb454e4a179dd1877ULL, 0x29babe4598c311fbULL,
+    0xe16a1dc9d8545e94ULL, 0xf4296dd6fef3d67aULL,
+    0x8ce2529e2734bb1dULL, 0x1899e4a65f58660cULL,
+    0xb01ae745b101e9e4ULL, 0x5ec05dcff72e7f8fULL,
+    0xdc21a1171d42645dULL, 0x76707543f4fa1f73ULL,
+    0x899504ae72497ebaULL, 0x6a06494a791c53a8ULL,
+    0xabfa45da0edbde69ULL, 0x0487db9d17636892ULL,
+    0xd6f8d7509292d603ULL, 0x45a9d2845d3c42b6ULL,
+    0x865b86925b9bc5c2ULL, 0x0b8a2392ba45a9b2ULL,
+    0xa7f26836f282b732ULL, 0x8e6cac7768d7141eULL,
+    0xd1ef0244af2364ffULL, 0x3207d795430cd926ULL,
+    0x8335616aed761f1fULL, 0x7f44e6bd49e807b8ULL,
+    0xa402b9c5a8d3a6e7ULL, 0x5f16206c9c6209a6ULL,
+    0xcd036837130890a1ULL, 0x36dba887c37a8c0fULL,
+    0x802221226be55a64ULL, 0xc2494954da2c9789ULL,
+    0xa02aa96b06deb0fdULL, 0xf2db9baa10b7bd6cULL,
+    0xc83553c5c8965d3dULL, 0x6f92829494e5acc7ULL,
+    0xfa42a8b73abbf48cULL, 0xcb772339ba1f17f9ULL,
+    0x9c69a97284b578d7ULL, 0xff2a760414536efbULL,
+    0xc38413cf25e2d70dULL, 0xfef5138519684abaULL,
+    0xf46518c2ef5b8cd1ULL, 0x7eb258665fc25d69ULL,
+    0x98bf2f79d5993802ULL, 0xef2f773ffbd97a61ULL,
+    0xbeeefb584aff8603ULL, 0xaafb550ffacfd8faULL,
+    0xeeaaba2e5dbf6784ULL, 0x95ba2a53f983cf38ULL,
+    0x952ab45cfa97a0b2ULL, 0xdd945a747bf26183ULL,
+    0xba756174393d88dfULL, 0x94f971119aeef9e4ULL,
+    0xe912b9d1478ceb17ULL, 0x7a37cd5601aab85dULL,
+    0x91abb422ccb812eeULL, 0xac62e055c10ab33aULL,
+    0xb616a12b7fe617aaULL, 0x577b986b314d6009ULL,
+    0xe39c49765fdf9d94ULL, 0xed5a7e85fda0b80bULL,
+    0x8e41ade9fbebc27dULL, 0x14588f13be847307ULL,
+    0xb1d219647ae6b31cULL, 0x596eb2d8ae258fc8ULL,
+    0xde469fbd99a05fe3ULL, 0x6fca5f8ed9aef3bbULL,
+    0x8aec23d680043beeULL, 0x25de7bb9480d5854ULL,
+    0xada72ccc20054ae9ULL, 0xaf561aa79a10ae6aULL,
+    0xd910f7ff28069da4ULL, 0x1b2ba1518094da04ULL,
+    0x87aa9aff79042286ULL, 0x90fb44d2f05d0842ULL,
+    0xa99541bf57452b28ULL, 0x353a1607ac744a53ULL,
+    0xd3fa922f2d1675f2ULL, 0x42889b8997915ce8ULL,
+    0x847c9b5d7c2e09b7ULL, 0x69956135febada11ULL,
+    0xa59bc234db398c25ULL, 0x43fab9837e699095ULL,
+    0xcf02b2c21207ef2eULL, 0x94f967e45e03f4bbULL,
+    0x8161afb94b44f57dULL, 0x1d1be0eebac278f5ULL,
+    0xa1ba1ba79e1632dcULL, 0x6462d92a69731732ULL,
+    0xca28a291859bbf93ULL, 0x7d7b8f7503cfdcfeULL,
+    0xfcb2cb35e702af78ULL, 0x5cda735244c3d43eULL,
+    0x9defbf01b061adabULL, 0x3a0888136afa64a7ULL,
+    0xc56baec21c7a1916ULL, 0x088aaa1845b8fdd0ULL,
+    0xf6c69a72a3989f5bULL, 0x8aad549e57273d45ULL,
+    0x9a3c2087a63f6399ULL, 0x36ac54e2f678864bULL,
+    0xc0cb28a98fcf3c7fULL, 0x84576a1bb416a7ddULL,
+    0xf0fdf2d3f3c30b9fULL, 0x656d44a2a11c51d5ULL,
+    0x969eb7c47859e743ULL, 0x9f644ae5a4b1b325ULL,
+    0xbc4665b596706114ULL, 0x873d5d9f0dde1feeULL,
+    0xeb57ff22fc0c7959ULL, 0xa90cb506d155a7eaULL,
+    0x9316ff75dd87cbd8ULL, 0x09a7f12442d588f2ULL,
+    0xb7dcbf5354e9beceULL, 0x0c11ed6d538aeb2fULL,
+    0xe5d3ef282a242e81ULL, 0x8f1668c8a86da5faULL,
+    0x8fa475791a569d10ULL, 0xf96e017d694487bcULL,
+    0xb38d92d760ec4455ULL, 0x37c981dcc395a9acULL,
+    0xe070f78d3927556aULL, 0x85bbe253f47b1417ULL,
+    0x8c469ab843b89562ULL, 0x93956d7478ccec8eULL,
+    0xaf58416654a6babbULL, 0x387ac8d1970027b2ULL,
+    0xdb2e51bfe9d0696aULL, 0x06997b05fcc0319eULL,
+    0x88fcf317f22241e2ULL, 0x441fece3bdf81f03ULL,
+    0xab3c2fddeeaad25aULL, 0xd527e81cad7626c3ULL,
+    0xd60b3bd56a5586f1ULL, 0x8a71e223d8d3b074ULL,
+    0x85c7056562757456ULL, 0xf6872d5667844e49ULL,
+    0xa738c6bebb12d16cULL, 0xb428f8ac016561dbULL,
+    0xd106f86e69d785c7ULL, 0xe13336d701beba52ULL,
+    0x82a45b450226b39cULL, 0xecc0024661173473ULL,
+    0xa34d721642b06084ULL, 0x27f002d7f95d0190ULL,
+    0xcc20ce9bd35c78a5ULL, 0x31ec038df7b441f4ULL,
+    0xff290242c83396ceULL, 0x7e67047175a15271ULL,
+    0x9f79a169bd203e41ULL, 0x0f0062c6e984d386ULL,
+    0xc75809c42c684dd1ULL, 0x52c07b78a3e60868ULL,
+    0xf92e0c3537826145ULL, 0xa7709a56ccdf8a82ULL,
+    0x9bbcc7a142b17ccbULL, 0x88a66076400bb691ULL,
+    0xc2abf989935ddbfeULL, 0x6acff893d00ea435ULL,
+    0xf356f7ebf83552feULL, 0x0583f6b8c4124d43ULL,
+    0x98165af37b2153deULL, 0xc3727a337a8b704aULL,
+    0xbe1bf1b059e9a8d6ULL, 0x744f18c0592e4c5cULL,
+    0xeda2ee1c7064130cULL, 0x1162def06f79df73ULL,
+    0x9485d4d1c63e8be7ULL, 0x8addcb5645ac2ba8ULL,
+    0xb9a74a0637ce2ee1ULL, 0x6d953e2bd7173692ULL,
+    0xe8111c87c5c1ba99ULL, 0xc8fa8db6ccdd0437ULL,
+    0x910ab1d4db9914a0ULL, 0x1d9c9892400a22a2ULL,
+    0xb54d5e4a127f59c8ULL, 0x2503beb6d00cab4bULL,
+    0xe2a0b5dc971f303aULL, 0x2e44ae64840fd61dULL,
+    0x8da471a9de737e24ULL, 0x5ceaecfed289e5d2ULL,
+    0xb10d8e1456105dadULL, 0x7425a83e872c5f47ULL,
+    0xdd50f1996b947518ULL, 0xd12f124e28f77719ULL,
+    0x8a5296ffe33cc92fULL, 0x82bd6b70d99aaa6fULL,
+    0xace73cbfdc0bfb7bULL, 0x636cc64d1001550bULL,
+    0xd8210befd30efa5aULL, 0x3c47f7e05401aa4eULL,
+    0x8714a775e3e95c78ULL, 0x65acfaec34810a71ULL,
+    0xa8d9d1535ce3b396ULL, 0x7f1839a741a14d0dULL,
+    0xd31045a8341ca07cULL, 0x1ede48111209a050ULL,
+    0x83ea2b892091e44dULL, 0x934aed0aab460432ULL,
+    0xa4e4b66b68b65d60ULL, 0xf81da84d5617853fULL,
+    0xce1de40642e3f4b9ULL, 0x36251260ab9d668eULL,
+    0x80d2ae83e9ce78f3ULL, 0xc1d72b7c6b426019ULL,
+    0xa1075a24e4421730ULL, 0xb24cf65b8612f81fULL,
+    0xc94930ae1d529cfcULL, 0xdee033f26797b627ULL,
+    0xfb9b7cd9a4a7443cULL, 0x169840ef017da3b1ULL,
+    0x9d412e0806e88aa5ULL, 0x8e1f289560ee864eULL,
+    0xc491798a08a2ad4eULL, 0xf1a6f2bab92a27e2ULL,
+    0xf5b5d7ec8acb58a2ULL, 0xae10af696774b1dbULL,
+    0x9991a6f3d6bf1765ULL, 0xacca6da1e0a8ef29ULL,
+    0xbff610b0cc6edd3fULL, 0x17fd090a58d32af3ULL,
+    0xeff394dcff8a948eULL, 0xddfc4b4cef07f5b0ULL,
+    0x95f83d0a1fb69cd9ULL, 0x4abdaf101564f98eULL,
+    0xbb764c4ca7a4440fULL, 0x9d6d1ad41abe37f1ULL,
+    0xea53df5fd18d5513ULL, 0x84c86189216dc5edULL,
+    0x92746b9be2f8552cULL, 0x32fd3cf5b4e49bb4ULL,
+    0xb7118682dbb66a77ULL, 0x3fbc8c33221dc2a1ULL,
+    0xe4d5e82392a40515ULL, 0x0fabaf3feaa5334aULL,
+    0x8f05b1163ba6832dULL, 0x29cb4d87f2a7400eULL,
+    0xb2c71d5bca9023f8ULL, 0x743e20e9ef511012ULL,
+    0xdf78e4b2bd342cf6ULL, 0x914da9246b255416ULL,
+    0x8bab8eefb6409c1aULL, 0x1ad089b6c2f7548eULL,
+    0xae9672aba3d0c320ULL, 0xa184ac2473b529b1ULL,
+    0xda3c0f568cc4f3e8ULL, 0xc9e5d72d90a2741eULL,
+    0x8865899617fb1871ULL, 0x7e2fa67c7a658892ULL,
+    0xaa7eebfb9df9de8dULL, 0xddbb901b98feeab7ULL,
+    0xd51ea6fa85785631ULL, 0x552a74227f3ea565ULL,
+    0x8533285c936b35deULL, 0xd53a88958f87275fULL,
+    0xa67ff273b8460356ULL, 0x8a892abaf368f137ULL,
+    0xd01fef10a657842cULL, 0x2d2b7569b0432d85ULL,
+    0x8213f56a67f6b29bULL, 0x9c3b29620e29fc73ULL,
+    0xa298f2c501f45f42ULL, 0x8349f3ba91b47b8fULL,
+    0xcb3f2f7642717713ULL, 0x241c70a936219a73ULL,
+    0xfe0efb53d30dd4d7ULL, 0xed238cd383aa0110ULL,
+    0x9ec95d1463e8a506ULL, 0xf4363804324a40aaULL,
+    0xc67bb4597ce2ce48ULL, 0xb143c6053edcd0d5ULL,
+    0xf81aa16fdc1b81daULL, 0xdd94b7868e94050aULL,
+    0x9b10a4e5e9913128ULL, 0xca7cf2b4191c8326ULL,
+    0xc1d4ce1f63f57d72ULL, 0xfd1c2f611f63a3f0ULL,
+    0xf24a01a73cf2dccfULL, 0xbc633b39673c8cecULL,
+    0x976e41088617ca01ULL, 0xd5be0503e085d813ULL,
+    0xbd49d14aa79dbc82ULL, 0x4b2d8644d8a74e18ULL,
+    0xec9c459d51852ba2ULL, 0xddf8e7d60ed1219eULL,
+    0x93e1ab8252f33b45ULL, 0xcabb90e5c942b503ULL,
+    0xb8da1662e7b00a17ULL, 0x3d6a751f3b936243ULL,
+    0xe7109bfba19c0c9dULL, 0x0cc512670a783ad4ULL,
+    0x906a617d450187e2ULL, 0x27fb2b80668b24c5ULL,
+    0xb484f9dc9641e9daULL, 0xb1f9f660802dedf6ULL,
+    0xe1a63853bbd26451ULL, 0x5e7873f8a0396973ULL,
+    0x8d07e33455637eb2ULL, 0xdb0b487b6423e1e8ULL,
+    0xb049dc016abc5e5fULL, 0x91ce1a9a3d2cda62ULL,
+    0xdc5c5301c56b75f7ULL, 0x7641a140cc7810fbULL,
+    0x89b9b3e11b6329baULL, 0xa9e904c87fcb0a9dULL,
+    0xac2820d9623bf429ULL, 0x546345fa9fbdcd44ULL,
+    0xd732290fbacaf133ULL, 0xa97c177947ad4095ULL,
+    0x867f59a9d4bed6c0ULL, 0x49ed8eabcccc485dULL,
+    0xa81f301449ee8c70ULL, 0x5c68f256bfff5a74ULL,
+    0xd226fc195c6a2f8cULL, 0x73832eec6fff3111ULL,
+    0x83585d8fd9c25db7ULL, 0xc831fd53c5ff7eabULL,
+    0xa42e74f3d032f525ULL, 0xba3e7ca8b77f5e55ULL,
+    0xcd3a1230c43fb26fULL, 0x28ce1bd2e55f35ebULL,
+    0x80444b5e7aa7cf85ULL, 0x7980d163cf5b81b3ULL,
+    0xa0555e361951c366ULL, 0xd7e105bcc332621fULL,
+    0xc86ab5c39fa63440ULL, 0x8dd9472bf3fefaa7ULL,
+    0xfa856334878fc150ULL, 0xb14f98f6f0feb951ULL,
+    0x9c935e00d4b9d8d2ULL, 0x6ed1bf9a569f33d3ULL,
+    0xc3b8358109e84f07ULL, 0x0a862f80ec4700c8ULL,
+    0xf4a642e14c6262c8ULL, 0xcd27bb612758c0faULL,
+    0x98e7e9cccfbd7dbdULL, 0x8038d51cb897789cULL,
+    0xbf21e44003acdd2cULL, 0xe0470a63e6bd56c3ULL,
+    0xeeea5d5004981478ULL, 0x1858ccfce06cac74ULL,
+    0x95527a5202df0ccbULL, 0x0f37801e0c43ebc8ULL,
+    0xbaa718e68396cffdULL, 0xd30560258f54e6baULL,
+    0xe950df20247c83fdULL, 0x47c6b82ef32a2069ULL,
+    0x91d28b7416cdd27eULL, 0x4cdc331d57fa5441ULL,
+    0xb6472e511c81471dULL, 0xe0133fe4adf8e952ULL,
+    0xe3d8f9e563a198e5ULL, 0x58180fddd97723a6ULL,
+    0x8e679c2f5e44ff8fULL, 0x570f09eaa7ea7648ULL,
+};
+
+static const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// The double closest to mantissa * 10^exponent, for a mantissa of at most
+// 19 digits. When both fit a double exactly, one IEEE multiply or divide
+// rounds correctly (Clinger's fast path). Otherwise the Eisel-Lemire
+// algorithm takes the top bits of the mantissa times the 128-bit power of
+// five, which is always enough for an exact mantissa.
+INTERNAL double compute_double(int64_t exponent, uint64_t mantissa, char negative) {
+    double value;
+    if (exponent >= -22 && exponent <= 22 && mantissa <= 1ULL << 53) {
+        value = (double)mantissa;
+        value = exponent < 0 ? value / *(exact_powers_of_ten - exponent) : value * *(exact_powers_of_ten + exponent);
+        return negative ? -value : value;
+    }
+    uint64_t bits;
+    if (mantissa == 0 || exponent < -342) {
+        bits = 0;
+    } else if (exponent > 308) {
+        bits = 0x7ffULL << 52;
+    } else {
+        int leading_zeros = __builtin_clzll(mantissa);
+        uint64_t w = mantissa << leading_zeros;
+        const uint64_t *power = powers_of_five + 2 * (exponent + 342);
+        __uint128_t product = (__uint128_t)w * *power;
+        uint64_t high = product >> 64;
+        uint64_t low = (uint64_t)product;
+        // The truncated power may have cost the bits that decide the
+        // rounding; its low word settles them.
+        if ((high & 0x1ff) == 0x1ff) {
+            uint64_t second_high = ((__uint128_t)w * *(power + 1)) >> 64;
+            low += second_high;
+            high += second_high > low;
+        }
+        int upper_bit = high >> 63;
+        int shift = upper_bit + 9;
+        uint64_t bits_mantissa = high >> shift;
+        int64_t power2 = (((152170 + 65536) * exponent) >> 16) + 63 + upper_bit - leading_zeros + 1023;
+        if (power2 <= 0) {
+            // Subnormal: shift down to the fixed exponent and round.
+            if (-power2 + 1 >= 64) {
+                bits_mantissa = 0;
+                power2 = 0;
+            } else {
+                bits_mantissa >>= -power2 + 1;
+                bits_mantissa += bits_mantissa & 1;
+                bits_mantissa >>= 1;
+                power2 = bits_mantissa < 1ULL << 52 ? 0 : 1;
+            }
+        } else {
+            // A tie exactly halfway rounds to even; only small exponents
+            // can produce one.
+            if (low <= 1 && exponent >= -4 && exponent <= 23 && (bits_mantissa & 3) == 1 && (bits_mantissa << shift) == high) {
+                bits_mantissa &= ~1ULL;
+            }
+            bits_mantissa += bits_mantissa & 1;
+            bits_mantissa >>= 1;
+            if (bits_mantissa >= 2ULL << 52) {
+                bits_mantissa = 1ULL << 52;
+                power2++;
+            }
+            bits_mantissa &= ~(1ULL << 52);
+            if (power2 >= 0x7ff) {
+                bits_mantissa = 0;
+                power2 = 0x7ff;
+            }
+        }
+        bits = bits_mantissa | (uint64_t)power2 << 52;
+    }
+    bits |= (uint64_t)negative << 63;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// strtod needs a terminated string, and the input is not one; a long
+// number is copied to the heap.
+INTERNAL double parse_double_fallback(const char *raw, size_t len) {
+    char buffer[NUMBER_BUFFER_SIZE];
+    char *text = len < NUMBER_BUFFER_SIZE ? buffer : (char *)malloc(len + 1);
+    memcpy(text, raw, len);
+    *(text + len) = '\0';
+    double value = strtod(text, NULL);
+    if (text != buffer) {
+        free(text);
+    }
+    return value;
+}
+
+// Returns 0 for a value the tape cannot hold.
+INTERNAL char append_value(dom *dom, const char *data, token token) {
+    const char *raw = data + token.offset;
+    switch (token.type) {
+        case STRING_TOKEN:
+            append_string(dom, '"', raw + 1, token.len - 2);
+            break;
+        case NUM_TOKEN:
+            return append_number(dom, raw, token.len);
+        case BOOL_TOKEN:
+            *reserve_words(dom, 1) = *raw == 't' ? 't' : 'f';
+            break;
+        default:
+            *reserve_words(dom, 1) = 'n';
+            break;
     }
     return 1;
 }
 
-int check_object_property(token_stream *token_stream, int depth) {
-    token key_token = next_token(token_stream); // "key"
-    if (key_token.type != STRING_TOKEN) {
-        return 0;
+// Decodes the escapes of a string already checked by the tokenizer into
+// out and returns the decoded length. A \u escape for half a surrogate
+// pair that has no other half becomes U+FFFD.
+INTERNAL size_t decode_string(const char *raw, size_t len, char *out) {
+    size_t pos = 0;
+    size_t written = 0;
+    while (pos < len) {
+        const char *backslash = memchr(raw + pos, '\\', len - pos);
+        size_t plain = backslash == NULL ? len - pos : (size_t)(backslash - raw) - pos;
+        memcpy(out + written, raw + pos, plain);
+        written += plain;
+        pos += plain;
+        if (pos == len) {
+            break;
+        }
+        char c = *(raw + pos + 1);
+        pos += 2;
+        switch (c) {
+            case 'b':
+                *(out + written++) = '\b';
+                break;
+            case 'f':
+                *(out + written++) = '\f';
+                break;
+            case 'n':
+                *(out + written++) = '\n';
+                break;
+            case 'r':
+                *(out + written++) = '\r';
+                break;
+            case 't':
+                *(out + written++) = '\t';
+                break;
+            case 'u': {
+                uint32_t codepoint = read_hex4(raw + pos);
+                pos += 4;
+                if (codepoint >= 0xd800 && codepoint < 0xdc00 && len - pos >= 6 && *(raw + pos) == '\\' && *(raw + pos + 1) == 'u') {
+                    uint32_t low = read_hex4(raw + pos + 2);
+                    if (low >= 0xdc00 && low < 0xe000) {
+                        codepoint = 0x10000 + ((codepoint - 0xd800) << 10) + (low - 0xdc00);
+                        pos += 6;
+                    }
+                }
+                if (codepoint >= 0xd800 && codepoint < 0xe000) {
+                    codepoint = 0xfffd;
+                }
+                written += encode_utf8(codepoint, out + written);
+                break;
+            }
+            default:
+                *(out + written++) = c;
+                break;
+        }
     }
-    token colon_token = next_token(token_stream); // :
-    if (colon_token.type != COLON_TOKEN) {
-        return 0;
+    return written;
+}
+
+INTERNAL size_t encode_utf8(uint32_t codepoint, char *out) {
+    if (codepoint < 0x80) {
+        *out = codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800) {
+        *out = 0xc0 | codepoint >> 6;
+        *(out + 1) = 0x80 | (codepoint & 0x3f);
+        return 2;
+    }
+    if (codepoint < 0x10000) {
+        *out = 0xe0 | codepoint >> 12;
+        *(out + 1) = 0x80 | ((codepoint >> 6) & 0x3f);
+        *(out + 2) = 0x80 | (codepoint & 0x3f);
+        return 3;
     }
-    return check_expression(token_stream, depth);
+    *out = 0xf0 | codepoint >> 18;
+    *(out + 1) = 0x80 | ((codepoint >> 12) & 0x3f);
+    *(out + 2) = 0x80 | ((codepoint >> 6) & 0x3f);
+    *(out + 3) = 0x80 | (codepoint & 0x3f);
+    return 4;
 }
 
-char is_option(string *arg) {
-    return arg->len > 0 && *(arg->buffer) == '-';
+INTERNAL uint32_t read_hex4(const char *hex) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = *(hex + i);
+        uint32_t digit = is_numeric(c) ? c - '0' : (c | 0x20) - 'a' + 10;
+        value = value << 4 | digit;
+    }
+    return value;
+}
+
+INTERNAL char dom_tag(dom *dom, size_t index) {
+    return *(dom->words + index) & 0xff;
+}
+
+// The index of the value after the one at index, skipping its subtree.
+INTERNAL size_t dom_next(dom *dom, size_t index) {
+    uint64_t word = *(dom->words + index);
+    switch (word & 0xff) {
+        case '[':
+        case '{':
+            return word >> 8;
+        case '"':
+        case 'k':
+            return index + 1 + ((word >> 8) + 8) / 8;
+        case 'l':
+        case 'd':
+            return index + 2;
+        default:
+            return index + 1;
+    }
 }
 
-int read_options(int argc, char **argv) {
-    int options = 0;
+INTERNAL const char *dom_string(dom *dom, size_t index, size_t *len) {
+    *len = *(dom->words + index) >> 8;
+    return (const char *)(dom->words + index + 1);
+}
+
+INTERNAL int64_t dom_int64(dom *dom, size_t index) {
+    int64_t value;
+    memcpy(&value, dom->words + index + 1, sizeof(value));
+    return value;
+}
+
+INTERNAL double dom_double(dom *dom, size_t index) {
+    double value;
+    memcpy(&value, dom->words + index + 1, sizeof(value));
+    return value;
+}
+
+INTERNAL void destroy_dom(dom *dom) {
+    free(dom->words);
+    dom->words = NULL;
+    dom->len = 0;
+    dom->alloc = 0;
+}
+
+// The tape already is the document in print order, so it is printed in
+// one pass: a value is preceded by ':' after a key, by ',' after a value
+// in the same container, and by nothing after an open.
+INTERNAL void print_dom(dom *dom, FILE *file) {
+    char prev = '[';
+    size_t index = 0;
+    while (index < dom->len) {
+        char tag = dom_tag(dom, index);
+        if (tag != ']' && tag != '}') {
+            if (prev == 'k') {
+                fputc(':', file);
+            } else if (prev != '[' && prev != '{') {
+                fputc(',', file);
+            }
+        }
+        prev = tag;
+        switch (tag) {
+            case '[':
+            case '{':
+            case ']':
+            case '}':
+                fputc(tag, file);
+                index++;
+                continue;
+            case '"':
+            case 'k': {
+                size_t len;
+                const char *string = dom_string(dom, index, &len);
+                print_json_string(string, len, file);
+                break;
+            }
+            case 'l':
+                fprintf(file, "%" PRId64, dom_int64(dom, index));
+                break;
+            case 'd':
+                fprintf(file, "%.17g", dom_double(dom, index));
+                break;
+            case 't':
+                fputs("true", file);
+                break;
+            case 'f':
+                fputs("false", file);
+                break;
+            default:
+                fputs("null", file);
+                break;
+        }
+        index = dom_next(dom, index);
+    }
+    fputc('\n', file);
+}
+
+// Prints the input between start and end without the whitespace between
+// its tokens.
+INTERNAL void print_compact(const char *data, size_t start, size_t end, FILE *file) {
+    size_t run = start;
+    char in_string = 0;
+    for (size_t i = start; i < end; i++) {
+        char c = *(data + i);
+        if (in_string) {
+            if (c == '\\') {
+                i++;
+            } else if (c == '"') {
+                in_string = 0;
+            }
+        } else if (c == '"') {
+            in_string = 1;
+        } else if (is_whitespace(c)) {
+            fwrite(data + run, sizeof(char), i - run, file);
+            run = i + 1;
+        }
+    }
+    fwrite(data + run, sizeof(char), end - run, file);
+}
+
+INTERNAL void print_json_string(const char *string, size_t len, FILE *file) {
+    fputc('"', file);
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = *(string + i);
+        if (c == '"' || c == '\\') {
+            fputc('\\', file);
+            fputc(c, file);
+        } else if (c < 0x20) {
+            fprintf(file, "\\u%04x", c);
+        } else {
+            fputc(c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+INTERNAL void read_options(int argc, char **argv, settings *settings) {
+    settings->options = 0;
+    settings->max_depth = DEFAULT_MAX_DEPTH;
+    settings->jobs = 1;
+    settings->select_path = NULL;
+    settings->chunk_size = READ_BUFFER_SIZE;
     string *file_option = create_str("-f");
     string *file_option_lg = create_str("--file");
-    for (int i = 1; i < argc; i++) {
+    string *max_depth_option = create_str("--max-depth");
+    string *parse_option = create_str("--parse");
+    string *ndjson_option = create_str("--ndjson");
+    string *select_option = create_str("--select");
+    string *stream_option = create_str("--stream");
+    string *chunk_size_option = create_str("--chunk-size");
+    string *jobs_option = create_str("-j");
+    string *quiet_option = create_str("-q");
+    int i = 1;
+    for (; i < argc; i++) {
         string *arg = create_str(*(argv + i));
         if (!is_option(arg)) {
-            continue;
+            destroy_str(arg);
+            break;
         }
         if (compare_str(arg, file_option) || compare_str(arg, file_option_lg)) {
-            options |= FILE_OPTION;
+            settings->options |= FILE_OPTION;
+        } else if (compare_str(arg, stream_option)) {
+            settings->options |= STREAM_OPTION;
+        } else if (compare_str(arg, chunk_size_option)) {
+            char *value = read_value(argc, argv, &i);
+            settings->chunk_size = read_number(value, READ_BUFFER_SIZE);
+            if (settings->chunk_size < 1) {
+                fprintf(stderr, "ccjsonparser: invalid chunk size '%s'\n", value);
+                exit(0);
+            }
+        } else if (compare_str(arg, select_option)) {
+            char *value = read_value(argc, argv, &i);
+            if (!is_valid_path(value)) {
+                fprintf(stderr, "ccjsonparser: invalid path '%s'\n", value);
+                exit(0);
+            }
+            settings->options |= SELECT_OPTION;
+            settings->select_path = value;
+        } else if (compare_str(arg, ndjson_option)) {
+            settings->options |= NDJSON_OPTION;
+        } else if (compare_str(arg, jobs_option) || (arg->len > 2 && *(arg->buffer + 1) == 'j')) {
+            char *value = compare_str(arg, jobs_option) ? read_value(argc, argv, &i) : arg->buffer + 2;
+            settings->jobs = read_number(value, MAX_JOBS);
+            if (settings->jobs < 1) {
+                fprintf(stderr, "ccjsonparser: invalid number of jobs '%s'\n", value);
+                exit(0);
+            }
+        } else if (compare_str(arg, quiet_option)) {
+            settings->options |= QUIET_OPTION;
+        } else if (compare_str(arg, parse_option)) {
+            settings->options |= PARSE_OPTION;
+        } else if (compare_str(arg, max_depth_option)) {
+            char *value = read_value(argc, argv, &i);
+            settings->max_depth = read_number(value, MAX_DEPTH_LIMIT);
+            if (settings->max_depth < 1) {
+                fprintf(stderr, "ccjsonparser: invalid depth '%s'\n", value);
+                exit(0);
+            }
         } else {
             fprintf(stderr, "ccjsonparser: invalid option '%s'\n", arg->buffer);
         }
@@ -553,5 +3271,62 @@ int read_options(int argc, char **argv) {
     }
     destroy_str(file_option);
     destroy_str(file_option_lg);
-    return options;
+    destroy_str(max_depth_option);
+    destroy_str(parse_option);
+    destroy_str(ndjson_option);
+    destroy_str(select_option);
+    destroy_str(stream_option);
+    destroy_str(chunk_size_option);
+    destroy_str(jobs_option);
+    destroy_str(quiet_option);
+    if ((settings->options & SELECT_OPTION) && (settings->options & (PARSE_OPTION | NDJSON_OPTION))) {
+        fprintf(stderr, "ccjsonparser: --select cannot be used with --parse or --ndjson\n");
+        exit(0);
+    }
+    if ((settings->options & STREAM_OPTION) && (settings->options & (PARSE_OPTION | NDJSON_OPTION | SELECT_OPTION))) {
+        fprintf(stderr, "ccjsonparser: --stream cannot be used with --parse, --ndjson or --select\n");
+        exit(0);
+    }
+    settings->files_start = i;
+}
+
+INTERNAL char *read_value(int argc, char **argv, int *i) {
+    if (*i + 1 >= argc) {
+        fprintf(stderr, "ccjsonparser: option '%s' expects a value\n", *(argv + *i));
+        exit(0);
+    }
+    (*i)++;
+    return *(argv + *i);
+}
+
+// A JSON Pointer: empty, or segments that each start with '/', where '~'
+// is only used in the escapes "~0" and "~1".
+INTERNAL char is_valid_path(char *path) {
+    if (*path != '\0' && *path != '/') {
+        return 0;
+    }
+    for (char *c = path; *c != '\0'; c++) {
+        if (*c == '~' && *(c + 1) != '0' && *(c + 1) != '1') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Parses a decimal number in [0, max]; returns -1 for anything else.
+INTERNAL int read_number(char *arg, int max) {
+    int number = 0;
+    if (*arg == '\0') {
+        return -1;
+    }
+    for (char *c = arg; *c != '\0'; c++) {
+        if (*c < '0' || *c > '9') {
+            return -1;
+        }
+        number = number * 10 + (*c - '0');
+        if (number > max) {
+            return -1;
+        }
+    }
+    return number;
 }
@@ -0,0 +1,26 @@
+# Pipes every test document into --stream in pieces of several sizes and
+# checks each verdict against the whole-file check. Then checks that a
+# document that breaks early is reported while its writer still holds the
+# pipe open.
+mkdir -p bin
+clang -O2 main.c -o bin/json_parser -pthread
+failed=0
+for file in test/*.json; do
+    expected=$(./bin/json_parser "$file" | awk '{print $NF}')
+    for size in 1 2 3 7 64 4096; do
+        got=$(cat "$file" | ./bin/json_parser --stream --chunk-size "$size" | awk '{print $NF}')
+        if [ "$got" != "$expected" ]; then
+            echo "$file: --stream --chunk-size $size says $got, expected $expected"
+            failed=1
+        fi
+    done
+done
+got=$( (printf '[1, 2,'; sleep 1; printf ' ]'; sleep 3) | timeout 2 ./bin/json_parser --stream)
+if [ "$got" != "stdin invalid" ]; then
+    echo "an early error was not reported before the end of the input"
+    failed=1
+fi
+if [ "$failed" = 0 ]; then
+    echo "all documents agree"
+fi
+exit "$failed"
@@ -0,0 +1,17 @@
+# Generates the synthetic corpora (once) and measures every wc mode on
+# them. Results are printed as JSON; pick sizes with SIZES, e.g.
+#   SIZES="1M 1G 10G" ./bench.sh > results.json
+mkdir -p bin corpus
+clang -O2 main.c -o bin/wc -pthread
+clang -O2 bench/main.c -o bin/bench
+files=""
+for kind in prose whitespace longlines utf8 binary; do
+    for size in ${SIZES:-1M 64M}; do
+        file="corpus/$kind-$size"
+        if [ ! -f "$file" ]; then
+            ./bin/bench gen "$kind" "$size" "$file"
+        fi
+        files="$files $file"
+    done
+done
+./bin/bench run ./bin/wc $files
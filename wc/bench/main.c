@@ -0,0 +1,447 @@
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAS_TSC
+#endif
+
+#define WRITE_BUFFER_SIZE (1 << 20)
+#define RUNS 3
+#define SEED 0x9E3779B97F4A7C15ULL
+
+typedef enum corpus_kind {
+    PROSE_CORPUS,
+    WHITESPACE_CORPUS,
+    LONG_LINES_CORPUS,
+    UTF8_CORPUS,
+    BINARY_CORPUS,
+    BAD_CORPUS,
+} corpus_kind;
+
+// Deterministic xorshift64* generator, so a corpus of a given kind and
+// size is byte-for-byte the same on every machine.
+typedef struct rng {
+    uint64_t state;
+} rng;
+
+typedef struct corpus_writer {
+    FILE *file;
+    char *buffer;
+    size_t len;
+    uint64_t written;
+    uint64_t size;
+    uint64_t line_len;
+} corpus_writer;
+
+typedef struct measurement {
+    double seconds;
+    uint64_t cycles;
+    char cycles_source[8];
+    long peak_rss_kb;
+    char ok;
+} measurement;
+
+uint64_t next_random(rng *);
+uint64_t random_below(rng *, uint64_t);
+
+corpus_kind read_corpus_kind(char *);
+uint64_t read_size(char *);
+void generate(corpus_kind, uint64_t, char *);
+char write_bytes(corpus_writer *, const char *, size_t);
+char write_prose(corpus_writer *, rng *, char);
+char write_whitespace(corpus_writer *, rng *);
+char write_utf8(corpus_writer *, rng *);
+char write_binary(corpus_writer *, rng *);
+
+void run(char *, int, char **);
+measurement measure(char *, char *, char *);
+char start_cycle_counter(int *, pid_t);
+double now();
+
+int str_len(char *);
+int str_compare(char *, char *);
+
+const char *corpus_names[] = { "prose", "whitespace", "longlines", "utf8", "binary" };
+const char *modes[] = { "-c", "-l", "-w", "-m", NULL };
+const char *mode_names[] = { "bytes", "lines", "words", "chars", "default" };
+
+const char *words[] = {
+    "the", "of", "and", "to", "in", "a", "is", "that", "for", "it", "as", "was", "with", "be",
+    "by", "on", "not", "he", "this", "are", "or", "his", "from", "at", "which", "but", "have",
+    "an", "had", "they", "you", "were", "their", "one", "all", "we", "can", "her", "has",
+    "there", "been", "if", "more", "when", "will", "would", "who", "so", "no", "counting",
+    "throughput", "bandwidth", "newline", "character", "whitespace", "benchmark", "regression",
+};
+
+// Words in several scripts, plus the non-ASCII separators wc must split on
+// (U+00A0 and U+3000).
+const char *utf8_words[] = {
+    "caf\xc3\xa9", "na\xc3\xafve", "\xc3\xbc" "ber", "stra\xc3\x9f" "e",
+    "\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82", "\xd0\xbc\xd0\xb8\xd1\x80",
+    "\xce\xb1\xce\xb2\xce\xb3", "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e", "\xe4\xb8\xad\xe6\x96\x87",
+    "\xed\x95\x9c\xea\xb5\xad\xec\x96\xb4", "\xd8\xb9\xd8\xb1\xd8\xa8\xd9\x8a", "\xf0\x9f\x98\x80",
+    "\xf0\x9f\x9a\x80", "plain", "ascii", "log",
+};
+const char *utf8_separators[] = { " ", " ", " ", "\n", "\xc2\xa0", "\xe3\x80\x80" };
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "ccwc-bench error: missing command, expected 'gen' or 'run'.\n");
+        exit(1);
+    }
+    char *command = *(argv + 1);
+    if (str_compare(command, "gen")) {
+        if (argc != 5) {
+            fprintf(stderr, "ccwc-bench error: expected 'gen <kind> <size> <path>'.\n");
+            exit(1);
+        }
+        corpus_kind kind = read_corpus_kind(*(argv + 2));
+        if (kind == BAD_CORPUS) {
+            fprintf(stderr, "ccwc-bench error: invalid corpus kind '%s'.\n", *(argv + 2));
+            exit(1);
+        }
+        uint64_t size = read_size(*(argv + 3));
+        if (size == 0) {
+            fprintf(stderr, "ccwc-bench error: invalid size '%s'.\n", *(argv + 3));
+            exit(1);
+        }
+        generate(kind, size, *(argv + 4));
+    } else if (str_compare(command, "run")) {
+        if (argc < 4) {
+            fprintf(stderr, "ccwc-bench error: expected 'run <wc> <file>...'.\n");
+            exit(1);
+        }
+        run(*(argv + 2), argc - 3, argv + 3);
+    } else {
+        fprintf(stderr, "ccwc-bench error: invalid command '%s', expected 'gen' or 'run'.\n", command);
+        exit(1);
+    }
+    return 0;
+}
+
+uint64_t next_random(rng *rng) {
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return rng->state * 0x2545F4914F6CDD1DULL;
+}
+
+uint64_t random_below(rng *rng, uint64_t n) {
+    return next_random(rng) % n;
+}
+
+corpus_kind read_corpus_kind(char *name) {
+    for (int i = 0; i < BAD_CORPUS; i++) {
+        if (str_compare(name, (char *)*(corpus_names + i))) {
+            return (corpus_kind)i;
+        }
+    }
+    return BAD_CORPUS;
+}
+
+// Sizes are plain byte counts with an optional K, M or G suffix (powers
+// of 1024). Returns 0 for anything malformed.
+uint64_t read_size(char *arg) {
+    uint64_t size = 0;
+    char *c = arg;
+    for (; *c >= '0' && *c <= '9'; c++) {
+        size = size * 10 + (*c - '0');
+    }
+    if (*c == 'K' || *c == 'k') {
+        size <<= 10;
+        c++;
+    } else if (*c == 'M' || *c == 'm') {
+        size <<= 20;
+        c++;
+    } else if (*c == 'G' || *c == 'g') {
+        size <<= 30;
+        c++;
+    }
+    return c == arg || *c != '\0' ? 0 : size;
+}
+
+void generate(corpus_kind kind, uint64_t size, char *path) {
+    corpus_writer writer;
+    writer.file = fopen(path, "wb");
+    if (writer.file == NULL) {
+        fprintf(stderr, "ccwc-bench error: cannot create '%s'.\n", path);
+        exit(1);
+    }
+    writer.buffer = (char *)malloc(WRITE_BUFFER_SIZE);
+    writer.len = 0;
+    writer.written = 0;
+    writer.size = size;
+    writer.line_len = 0;
+    rng rng = { SEED + kind };
+    char more = 1;
+    while (more) {
+        switch (kind) {
+            case PROSE_CORPUS:
+                more = write_prose(&writer, &rng, 0);
+                break;
+            case WHITESPACE_CORPUS:
+                more = write_whitespace(&writer, &rng);
+                break;
+            case LONG_LINES_CORPUS:
+                more = write_prose(&writer, &rng, 1);
+                break;
+            case UTF8_CORPUS:
+                more = write_utf8(&writer, &rng);
+                break;
+            default:
+                more = write_binary(&writer, &rng);
+                break;
+        }
+    }
+    fwrite(writer.buffer, sizeof(char), writer.len, writer.file);
+    fclose(writer.file);
+    free(writer.buffer);
+}
+
+// Appends to the corpus, cutting the last write short at the target size.
+// Returns 0 once the corpus is complete.
+char write_bytes(corpus_writer *writer, const char *bytes, size_t len) {
+    if (writer->written + len > writer->size) {
+        len = writer->size - writer->written;
+    }
+    if (writer->len + len > WRITE_BUFFER_SIZE) {
+        fwrite(writer->buffer, sizeof(char), writer->len, writer->file);
+        writer->len = 0;
+    }
+    memcpy(writer->buffer + writer->len, bytes, len);
+    writer->len += len;
+    writer->written += len;
+    return writer->written < writer->size;
+}
+
+// A sentence of dictionary words. Regular prose breaks lines every 60 to
+// 100 characters; long lines only break every 64 to 128 KiB.
+char write_prose(corpus_writer *writer, rng *rng, char long_lines) {
+    uint64_t limit = long_lines ? (64 << 10) + random_below(rng, 64 << 10) : 60 + random_below(rng, 40);
+    int count = 3 + random_below(rng, 12);
+    for (int i = 0; i < count; i++) {
+        const char *word = *(words + random_below(rng, sizeof(words) / sizeof(*words)));
+        size_t len = strlen(word);
+        if (!write_bytes(writer, word, len)) {
+            return 0;
+        }
+        writer->line_len += len + 1;
+        const char *separator = i == count - 1 ? ". " : " ";
+        if (writer->line_len >= limit) {
+            separator = i == count - 1 ? ".\n" : "\n";
+            writer->line_len = 0;
+        }
+        if (!write_bytes(writer, separator, strlen(separator))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Single letters separated by runs of every ASCII whitespace byte, so
+// nearly every byte is a word boundary.
+char write_whitespace(corpus_writer *writer, rng *rng) {
+    const char *blanks = " \t\n\v\f\r";
+    char word = 'a' + random_below(rng, 26);
+    if (!write_bytes(writer, &word, 1)) {
+        return 0;
+    }
+    int run = 1 + random_below(rng, 4);
+    for (int i = 0; i < run; i++) {
+        char blank = *(blanks + random_below(rng, 6));
+        if (!write_bytes(writer, &blank, 1)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+char write_utf8(corpus_writer *writer, rng *rng) {
+    const char *word = *(utf8_words + random_below(rng, sizeof(utf8_words) / sizeof(*utf8_words)));
+    const char *separator = *(utf8_separators + random_below(rng, sizeof(utf8_separators) / sizeof(*utf8_separators)));
+    return write_bytes(writer, word, strlen(word)) && write_bytes(writer, separator, strlen(separator));
+}
+
+char write_binary(corpus_writer *writer, rng *rng) {
+    uint64_t block[512];
+    for (int i = 0; i < 512; i++) {
+        *(block + i) = next_random(rng);
+    }
+    return write_bytes(writer, (const char *)block, sizeof(block));
+}
+
+// Runs every mode over every file, keeps the fastest of RUNS runs and
+// prints one JSON object per measurement.
+void run(char *wc_path, int files_count, char **files) {
+    printf("[\n");
+    char first = 1;
+    for (int i = 0; i < files_count; i++) {
+        char *file = *(files + i);
+        struct stat st;
+        if (stat(file, &st) != 0) {
+            fprintf(stderr, "ccwc-bench error: file '%s' does not exist.\n", file);
+            exit(1);
+        }
+        for (int j = 0; j < 5; j++) {
+            measurement best;
+            best.ok = 0;
+            for (int k = 0; k < RUNS; k++) {
+                measurement m = measure(wc_path, (char *)*(modes + j), file);
+                if (!m.ok) {
+                    fprintf(stderr, "ccwc-bench error: '%s' failed on '%s'.\n", wc_path, file);
+                    exit(1);
+                }
+                if (!best.ok || m.seconds < best.seconds) {
+                    long peak_rss_kb = best.ok && best.peak_rss_kb > m.peak_rss_kb ? best.peak_rss_kb : m.peak_rss_kb;
+                    best = m;
+                    best.peak_rss_kb = peak_rss_kb;
+                }
+            }
+            double bytes = st.st_size;
+            printf("%s  {\"file\": \"%s\", \"bytes\": %" PRIu64 ", \"mode\": \"%s\", \"seconds\": %.6f, \"gb_per_s\": %.3f, ",
+                   first ? "" : ",\n", file, (uint64_t)st.st_size, *(mode_names + j), best.seconds,
+                   best.seconds > 0 ? bytes / best.seconds / 1e9 : 0.0);
+            if (*best.cycles_source != '\0' && bytes > 0) {
+                printf("\"cycles_per_byte\": %.3f, \"cycles_source\": \"%s\", ", best.cycles / bytes, best.cycles_source);
+            } else {
+                printf("\"cycles_per_byte\": null, \"cycles_source\": null, ");
+            }
+            printf("\"peak_rss_kb\": %ld}", best.peak_rss_kb);
+            fflush(stdout);
+            first = 0;
+        }
+    }
+    printf("\n]\n");
+}
+
+// Runs wc once with its output discarded. The child waits on a pipe until
+// the cycle counter is attached, so only wc itself is measured.
+measurement measure(char *wc_path, char *mode, char *file) {
+    measurement m;
+    memset(&m, 0, sizeof(m));
+    int go[2];
+    if (pipe(go) != 0) {
+        return m;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        char byte;
+        close(*(go + 1));
+        if (read(*go, &byte, 1) < 0) {
+            _exit(127);
+        }
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        if (mode != NULL) {
+            execl(wc_path, wc_path, mode, file, (char *)NULL);
+        } else {
+            execl(wc_path, wc_path, file, (char *)NULL);
+        }
+        _exit(127);
+    }
+    close(*go);
+    int perf_fd = -1;
+    char has_perf = start_cycle_counter(&perf_fd, pid);
+#ifdef HAS_TSC
+    uint64_t tsc_start = __rdtsc();
+#endif
+    double start = now();
+    if (write(*(go + 1), "g", 1) < 0) {
+        close(*(go + 1));
+        return m;
+    }
+    close(*(go + 1));
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        return m;
+    }
+    m.seconds = now() - start;
+#ifdef HAS_TSC
+    uint64_t tsc_cycles = __rdtsc() - tsc_start;
+#endif
+    m.peak_rss_kb = usage.ru_maxrss;
+    m.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    if (has_perf && read(perf_fd, &m.cycles, sizeof(m.cycles)) == sizeof(m.cycles)) {
+        strcpy(m.cycles_source, "perf");
+    }
+#ifdef HAS_TSC
+    else {
+        m.cycles = tsc_cycles;
+        strcpy(m.cycles_source, "tsc");
+    }
+#endif
+    if (perf_fd >= 0) {
+        close(perf_fd);
+    }
+    return m;
+}
+
+// Counts the child's CPU cycles (and its threads') from exec onwards.
+// Kernels that forbid perf events leave us with the time stamp counter.
+char start_cycle_counter(int *perf_fd, pid_t pid) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.disabled = 1;
+    attr.enable_on_exec = 1;
+    attr.inherit = 1;
+    attr.exclude_hv = 1;
+    *perf_fd = syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+    if (*perf_fd < 0) {
+        attr.exclude_kernel = 1;
+        *perf_fd = syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+    }
+    return *perf_fd >= 0;
+#else
+    (void)pid;
+    *perf_fd = -1;
+    return 0;
+#endif
+}
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int str_len(char *str) {
+    int len = 0;
+    while (*(str + len) != '\0') {
+        len++;
+    }
+    return len;
+}
+
+int str_compare(char *str1, char *str2) {
+    int len1 = str_len(str1);
+    int len2 = str_len(str2);
+    if (len1 != len2) {
+        return 0;
+    }
+    for (int i = 0; i < len1; i++) {
+        if (*(str1 + i) != *(str2 + i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
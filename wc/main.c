@@ -1,179 +1,1052 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <langinfo.h>
+#include <locale.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAS_X86_KERNELS
+#endif
 
 #define PAD 8
+#define READ_BUFFER_SIZE (1 << 20)
+#define BUFFER_ALIGNMENT 64
+#define MAX_JOBS 256
+#define MIN_CHUNK_SIZE (1 << 20)
+#define FILES_PER_JOB 16
+#define MAX_INTERVAL 86400
+#define CHECKPOINT_VERSION 1
 
 #define BYTE_COUNT (1 << 0)
 #define LINE_COUNT (1 << 1)
 #define WORDS_COUNT (1 << 2)
 #define CHARS_COUNT (1 << 3)
 
+#define UTF8_ACCEPT 0
+#define UTF8_REJECT 12
+#define UTF8_LAST_STATE 96
+#define ASCII_MASK 0x8080808080808080ULL
+
 typedef struct info {
     char *file_name;
-    int line_count;
-    int words_count;
-    int byte_count;
-    int chars_count;
+    uint64_t line_count;
+    uint64_t words_count;
+    uint64_t byte_count;
+    uint64_t chars_count;
 } info;
 
+// Regular files are mapped and handed out as a single span; pipes and
+// terminals are read in large aligned blocks into the stream's buffer.
 typedef struct char_stream {
-    FILE *file;
+    int fd;
     char *file_path;
-    char curr;
+    char *map;
+    size_t map_len;
+    char mapped;
+    char *buffer;
 } char_stream;
 
-void run_for_streams(int, char_stream *, int);
+// Counts a block of bytes into an info, carrying whether the previous
+// byte was whitespace so words that straddle two blocks count once.
+typedef void (*count_kernel)(info *, char *, const unsigned char *, size_t);
+
+// Everything a count needs to carry from one span to the next: the class
+// of the last character and the UTF-8 decoder state of a sequence that
+// may continue in the next span.
+typedef struct count_state {
+    char prev_ws;
+    uint32_t utf8_state;
+    uint32_t codepoint;
+} count_state;
+
+// How the input is counted. In a UTF-8 locale, words and characters need
+// the decoder, but blocks that are pure ASCII (with no sequence pending)
+// still go through the byte kernel.
+typedef struct count_engine {
+    count_kernel count_block;
+    char decode_utf8;
+    char utf8;
+} count_engine;
+
+// A byte range of a mapped file counted on its own thread. The class of
+// its first and last character is kept so the merge can join words that
+// were split by the chunk boundary.
+typedef struct chunk_job {
+    const char *span;
+    size_t len;
+    count_engine *engine;
+    info data;
+    char first_ws;
+    char last_ws;
+} chunk_job;
+
+// Where an incremental count stopped: the file it belongs to, how far it
+// got, the counts so far and the state needed to resume mid-word or
+// mid-sequence. The counts do not include the effect of ending the input
+// at offset, so appending more bytes simply continues from here.
+typedef struct checkpoint {
+    uint64_t device;
+    uint64_t inode;
+    uint64_t offset;
+    char utf8;
+    info data;
+    count_state state;
+} checkpoint;
+
+typedef struct settings {
+    int options;
+    int jobs;
+    int files_start;
+    char *checkpoint_path;
+    char follow;
+    int interval;
+} settings;
+
+typedef enum file_state {
+    FILE_PENDING,
+    FILE_COUNTED,
+    FILE_MISSING,
+} file_state;
+
+// Counts many files on a pool of workers. Workers claim the next path,
+// open it, count it and park the result in a ring of slots; the printing
+// thread drains the ring in argument order. A worker never runs more than
+// the ring size ahead of the printer, which bounds both memory and the
+// number of open files.
+typedef struct file_scheduler {
+    char **file_paths;
+    int count;
+    int next_file;
+    int next_print;
+    int slots_count;
+    info *slots;
+    file_state *states;
+    info total_data;
+    count_engine *engine;
+    pthread_mutex_t lock;
+    pthread_cond_t counted;
+    pthread_cond_t printed;
+} file_scheduler;
+
+void run_for_streams(int, char **, int, int);
+void run_for_streams_parallel(int, char **, info *, count_engine *, int, int, int);
+void *count_files(void *);
+void add_info(info *, info *);
+void count_stream(char_stream *, info *, count_engine *);
+char count_stream_parallel(char_stream *, info *, count_engine *, int);
+void *count_chunk(void *);
+size_t next_char_boundary(const char *, size_t, size_t);
+
+void run_incremental(char *, settings *);
+char update_checkpoint(checkpoint *, char *, count_engine *);
+void reset_checkpoint(checkpoint *, struct stat *, char);
+char load_checkpoint(char *, checkpoint *);
+void save_checkpoint(char *, checkpoint *);
+void print_checkpoint(checkpoint *, char *, int, int);
+int watch_file(int, int, char *);
+void wait_for_change(int *, int *, char *, int);
 
 char_stream create_char_stream(char *);
-char peek_char(char_stream *);
-char next_char(char_stream *);
+char open_char_stream(char_stream *, char *);
+char map_file(int, char **, size_t *);
+size_t next_span(char_stream *, const char **);
 void destroy_char_stream(char_stream *);
 
+count_engine create_count_engine(int);
+char is_utf8_locale();
+count_kernel select_count_kernel();
+void init_count_state(count_state *);
+void count_span(count_engine *, info *, count_state *, const unsigned char *, size_t);
+void count_utf8(info *, count_state *, const unsigned char *, size_t);
+void finish_count(info *, count_state *);
+char starts_with_whitespace(count_engine *, const unsigned char *, size_t);
+char is_ascii_group(const unsigned char *);
+void count_block_scalar(info *, char *, const unsigned char *, size_t);
+void count_masks(info *, char *, uint64_t, uint64_t, uint64_t);
+#ifdef HAS_X86_KERNELS
+void count_block_sse2(info *, char *, const unsigned char *, size_t);
+void count_block_avx2(info *, char *, const unsigned char *, size_t);
+#endif
+
 char is_option(char *);
-int read_options(int, char **);
+void read_options(int, char **, settings *);
+char *read_value(int, char **, int *);
+int read_number(char *, int);
 
 int str_len(char *);
 char str_compare(char *, char *);
 char is_whitespace(char);
-int count_digits(int);
+char is_unicode_whitespace(uint32_t);
+int count_digits(uint64_t);
 
-void print_value(int);
-void print_info(info, int);
+int column_width(int, char **);
+void print_value(uint64_t, int);
+void print_info(info, int, int);
 
 int main(int argc, char **argv) {
-    int options = read_options(argc, argv);
-    int i = 1;
-    while (i < argc && is_option(*(argv + i))) {
-        i++;
-    }
+    settings settings;
+    read_options(argc, argv, &settings);
+    int i = settings.files_start;
     int files_count = argc - i;
-    int streams_count;
-    char_stream *streams = NULL;
-    if (files_count == 0) {
-        char_stream stream = create_char_stream(NULL);
-        streams = (char_stream *)malloc(sizeof(char_stream));
-        *streams = stream;
-        streams_count = 1;
+    if (settings.checkpoint_path != NULL || settings.follow) {
+        if (files_count != 1) {
+            fprintf(stderr, "ccwc: '--checkpoint' and '--follow' expect exactly one file\n");
+            exit(0);
+        }
+        run_incremental(*(argv + i), &settings);
+    } else if (files_count == 0) {
+        char *stdin_path = NULL;
+        run_for_streams(1, &stdin_path, settings.options, settings.jobs);
     } else {
-        char **files = argv + i;
-        streams = (char_stream *)malloc(files_count * sizeof(char_stream));
-        for (int j = 0; j < files_count; j++) {
-            char_stream stream = create_char_stream(*(files + j));
-            *(streams + j) = stream;
+        run_for_streams(files_count, argv + i, settings.options, settings.jobs);
+    }
+}
+
+// Streams are opened lazily, one at a time per worker, so the number of
+// files is not limited by the number of descriptors we may hold.
+void run_for_streams(int count, char **file_paths, int options, int jobs) {
+    info total_data = { "total", 0, 0, 0, 0 };
+    count_engine engine = create_count_engine(options);
+    int width = column_width(count, file_paths);
+    if (count > 1 && jobs > 1) {
+        run_for_streams_parallel(count, file_paths, &total_data, &engine, options, width, jobs);
+        print_info(total_data, options, width);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        char_stream stream = create_char_stream(*(file_paths + i));
+        info local_data = { stream.file_path, 0, 0, 0, 0 };
+        if (jobs <= 1 || !count_stream_parallel(&stream, &local_data, &engine, jobs)) {
+            count_stream(&stream, &local_data, &engine);
         }
-        streams_count = files_count;
+        destroy_char_stream(&stream);
+        add_info(&total_data, &local_data);
+        print_info(local_data, options, width);
     }
-    run_for_streams(streams_count, streams, options);
-    for (int j = 0; j < streams_count; j++) {
-        destroy_char_stream(streams + j);
+    if (count > 1) {
+        print_info(total_data, options, width);
     }
-    free(streams);
 }
 
-void run_for_streams(int count, char_stream *streams, int options) {
-    info total_data = { "total", 0, 0, 0, 0 };
+void run_for_streams_parallel(int count, char **file_paths, info *total_data, count_engine *engine, int options, int width, int jobs) {
+    if (jobs > count) {
+        jobs = count;
+    }
+    file_scheduler scheduler;
+    scheduler.file_paths = file_paths;
+    scheduler.count = count;
+    scheduler.next_file = 0;
+    scheduler.next_print = 0;
+    scheduler.slots_count = jobs * FILES_PER_JOB;
+    scheduler.slots = (info *)malloc(scheduler.slots_count * sizeof(info));
+    scheduler.states = (file_state *)malloc(scheduler.slots_count * sizeof(file_state));
+    for (int i = 0; i < scheduler.slots_count; i++) {
+        *(scheduler.states + i) = FILE_PENDING;
+    }
+    scheduler.total_data = *total_data;
+    scheduler.engine = engine;
+    pthread_mutex_init(&scheduler.lock, NULL);
+    pthread_cond_init(&scheduler.counted, NULL);
+    pthread_cond_init(&scheduler.printed, NULL);
+    pthread_t *threads = (pthread_t *)malloc(jobs * sizeof(pthread_t));
+    for (int i = 0; i < jobs; i++) {
+        pthread_create(threads + i, NULL, count_files, &scheduler);
+    }
     for (int i = 0; i < count; i++) {
-        char_stream *stream = streams + i;
-        info local_data = { stream->file_path, 0, 0, 0, 0 };
-        char prev = EOF;
-        char c = next_char(stream);
-        while (c != EOF) {
-            if (!options || options & LINE_COUNT) {
-                if (c == '\n') {
-                    local_data.line_count++;
-                    total_data.line_count++;
-                }
-            }
-            if (!options || options & WORDS_COUNT) {
-                if (is_whitespace(c) && !is_whitespace(prev)) {
-                    local_data.words_count++;
-                    total_data.words_count++;
-                }
-            }
-            if (!options || options & BYTE_COUNT) {
-                local_data.byte_count++;
-                total_data.byte_count++;
-            }
-            if (options & CHARS_COUNT) {
-                if ((c & 0xC0) != 0x80) {
-                    local_data.chars_count++;
-                    total_data.chars_count++;
-                }
-            }
-            prev = c;
-            c = next_char(stream);
+        int slot = i % scheduler.slots_count;
+        pthread_mutex_lock(&scheduler.lock);
+        while (*(scheduler.states + slot) == FILE_PENDING) {
+            pthread_cond_wait(&scheduler.counted, &scheduler.lock);
         }
-        if (!options || options & WORDS_COUNT) {
-            if (is_whitespace(c) && !is_whitespace(prev)) {
-                local_data.words_count++;
-                total_data.words_count++;
-            }
+        file_state state = *(scheduler.states + slot);
+        info data = *(scheduler.slots + slot);
+        pthread_mutex_unlock(&scheduler.lock);
+        if (state == FILE_MISSING) {
+            fprintf(stderr, "ccwc: file '%s' does not exist\n", *(file_paths + i));
+            exit(0);
         }
-        print_info(local_data, options);
+        print_info(data, options, width);
+        pthread_mutex_lock(&scheduler.lock);
+        *(scheduler.states + slot) = FILE_PENDING;
+        scheduler.next_print++;
+        pthread_cond_broadcast(&scheduler.printed);
+        pthread_mutex_unlock(&scheduler.lock);
     }
-    if (count > 1) {
-        print_info(total_data, options);
+    for (int i = 0; i < jobs; i++) {
+        pthread_join(*(threads + i), NULL);
+    }
+    *total_data = scheduler.total_data;
+    pthread_cond_destroy(&scheduler.printed);
+    pthread_cond_destroy(&scheduler.counted);
+    pthread_mutex_destroy(&scheduler.lock);
+    free(threads);
+    free(scheduler.states);
+    free(scheduler.slots);
+}
+
+void *count_files(void *arg) {
+    file_scheduler *scheduler = (file_scheduler *)arg;
+    while (1) {
+        pthread_mutex_lock(&scheduler->lock);
+        int i = scheduler->next_file++;
+        while (i < scheduler->count && i >= scheduler->next_print + scheduler->slots_count) {
+            pthread_cond_wait(&scheduler->printed, &scheduler->lock);
+        }
+        pthread_mutex_unlock(&scheduler->lock);
+        if (i >= scheduler->count) {
+            break;
+        }
+        char_stream stream;
+        info data = { *(scheduler->file_paths + i), 0, 0, 0, 0 };
+        file_state state = FILE_MISSING;
+        if (open_char_stream(&stream, *(scheduler->file_paths + i))) {
+            count_stream(&stream, &data, scheduler->engine);
+            destroy_char_stream(&stream);
+            __atomic_fetch_add(&scheduler->total_data.line_count, data.line_count, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&scheduler->total_data.words_count, data.words_count, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&scheduler->total_data.byte_count, data.byte_count, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&scheduler->total_data.chars_count, data.chars_count, __ATOMIC_RELAXED);
+            state = FILE_COUNTED;
+        }
+        int slot = i % scheduler->slots_count;
+        pthread_mutex_lock(&scheduler->lock);
+        *(scheduler->slots + slot) = data;
+        *(scheduler->states + slot) = state;
+        pthread_cond_broadcast(&scheduler->counted);
+        pthread_mutex_unlock(&scheduler->lock);
     }
+    return NULL;
+}
+
+void add_info(info *total, info *data) {
+    total->line_count += data->line_count;
+    total->words_count += data->words_count;
+    total->byte_count += data->byte_count;
+    total->chars_count += data->chars_count;
+}
+
+void count_stream(char_stream *stream, info *data, count_engine *engine) {
+    count_state state;
+    init_count_state(&state);
+    const char *span;
+    size_t len;
+    while ((len = next_span(stream, &span)) > 0) {
+        count_span(engine, data, &state, (const unsigned char *)span, len);
+    }
+    finish_count(data, &state);
+}
+
+// Splits a mapped file into one byte range per job and counts them
+// concurrently. Returns 0 when the stream is not worth splitting (pipes,
+// small files) so the caller falls back to the serial path.
+char count_stream_parallel(char_stream *stream, info *data, count_engine *engine, int jobs) {
+    if (!stream->mapped || stream->map_len < 2 * MIN_CHUNK_SIZE) {
+        return 0;
+    }
+    size_t size = stream->map_len;
+    if ((size_t)jobs > size / MIN_CHUNK_SIZE) {
+        jobs = size / MIN_CHUNK_SIZE;
+    }
+    chunk_job *chunks = (chunk_job *)malloc(jobs * sizeof(chunk_job));
+    pthread_t *threads = (pthread_t *)malloc(jobs * sizeof(pthread_t));
+    size_t chunk_size = size / jobs;
+    size_t start = 0;
+    for (int i = 0; i < jobs; i++) {
+        size_t end = size;
+        if (i < jobs - 1) {
+            end = engine->decode_utf8 ? next_char_boundary(stream->map, size, (i + 1) * chunk_size) : (i + 1) * chunk_size;
+        }
+        chunk_job *chunk = chunks + i;
+        chunk->span = stream->map + start;
+        chunk->len = end - start;
+        chunk->engine = engine;
+        pthread_create(threads + i, NULL, count_chunk, chunk);
+        start = end;
+    }
+    for (int i = 0; i < jobs; i++) {
+        pthread_join(*(threads + i), NULL);
+        chunk_job *chunk = chunks + i;
+        add_info(data, &chunk->data);
+        // Each chunk starts as if preceded by whitespace, so a word split by
+        // the boundary was counted by both sides.
+        if (i > 0 && !(chunk - 1)->last_ws && !chunk->first_ws) {
+            data->words_count--;
+        }
+    }
+    free(threads);
+    free(chunks);
+    return 1;
+}
+
+void *count_chunk(void *arg) {
+    chunk_job *chunk = (chunk_job *)arg;
+    info data = { NULL, 0, 0, 0, 0 };
+    count_state state;
+    init_count_state(&state);
+    const unsigned char *span = (const unsigned char *)chunk->span;
+    chunk->first_ws = chunk->len == 0 || starts_with_whitespace(chunk->engine, span, chunk->len);
+    count_span(chunk->engine, &data, &state, span, chunk->len);
+    finish_count(&data, &state);
+    chunk->last_ws = state.prev_ws;
+    chunk->data = data;
+    return NULL;
+}
+
+// Moves a chunk boundary past at most three continuation bytes. Either it
+// lands on a lead byte, or on a byte preceded by three continuation bytes,
+// where no valid sequence can still be open. In both cases the decoder of
+// a serial count would be in its initial state there too.
+size_t next_char_boundary(const char *span, size_t len, size_t pos) {
+    for (int i = 0; i < 3 && pos < len && (*(span + pos) & 0xC0) == 0x80; i++) {
+        pos++;
+    }
+    return pos;
+}
+
+// Counts only what was appended since the last run. The checkpoint is
+// loaded from and saved to settings->checkpoint_path when one is given;
+// with --follow the file is then watched and the counts printed again,
+// at most once per interval, whenever it grows.
+void run_incremental(char *file_path, settings *settings) {
+    count_engine engine = create_count_engine(0);
+    checkpoint checkpoint;
+    struct stat st;
+    if (stat(file_path, &st) != 0) {
+        fprintf(stderr, "ccwc: file '%s' does not exist\n", file_path);
+        exit(0);
+    }
+    int width = column_width(1, &file_path);
+    if (settings->checkpoint_path == NULL || !load_checkpoint(settings->checkpoint_path, &checkpoint)) {
+        reset_checkpoint(&checkpoint, &st, engine.utf8);
+    }
+    update_checkpoint(&checkpoint, file_path, &engine);
+    print_checkpoint(&checkpoint, file_path, settings->options, width);
+    fflush(stdout);
+    if (settings->checkpoint_path != NULL) {
+        save_checkpoint(settings->checkpoint_path, &checkpoint);
+    }
+    if (!settings->follow) {
+        return;
+    }
+    int notify_fd = -1;
+    int watch = -1;
+#ifdef __linux__
+    notify_fd = inotify_init1(IN_CLOEXEC);
+    watch = watch_file(notify_fd, -1, file_path);
+#endif
+    while (1) {
+        wait_for_change(&notify_fd, &watch, file_path, settings->interval);
+        if (!update_checkpoint(&checkpoint, file_path, &engine)) {
+            continue;
+        }
+        print_checkpoint(&checkpoint, file_path, settings->options, width);
+        fflush(stdout);
+        if (settings->checkpoint_path != NULL) {
+            save_checkpoint(settings->checkpoint_path, &checkpoint);
+        }
+    }
+}
+
+// Counts the bytes appended since checkpoint->offset. A file that was
+// replaced or truncated is counted again from the start. Returns 1 when
+// anything was counted.
+char update_checkpoint(checkpoint *checkpoint, char *file_path, count_engine *engine) {
+    int fd = open(file_path, O_RDONLY);
+    struct stat st;
+    if (fd < 0) {
+        return 0;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 0;
+    }
+    char replaced = checkpoint->device != (uint64_t)st.st_dev || checkpoint->inode != (uint64_t)st.st_ino;
+    if (replaced || checkpoint->offset > (uint64_t)st.st_size || checkpoint->utf8 != engine->utf8) {
+        reset_checkpoint(checkpoint, &st, engine->utf8);
+        replaced = 1;
+    }
+    char *buffer = NULL;
+    posix_memalign((void **)&buffer, BUFFER_ALIGNMENT, READ_BUFFER_SIZE);
+    uint64_t start = checkpoint->offset;
+    while (checkpoint->offset < (uint64_t)st.st_size) {
+        uint64_t left = st.st_size - checkpoint->offset;
+        ssize_t len = pread(fd, buffer, left < READ_BUFFER_SIZE ? left : READ_BUFFER_SIZE, checkpoint->offset);
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (len <= 0) {
+            break;
+        }
+        count_span(engine, &checkpoint->data, &checkpoint->state, (const unsigned char *)buffer, len);
+        checkpoint->offset += len;
+    }
+    free(buffer);
+    close(fd);
+    return replaced || checkpoint->offset != start;
+}
+
+void reset_checkpoint(checkpoint *checkpoint, struct stat *st, char utf8) {
+    checkpoint->device = st->st_dev;
+    checkpoint->inode = st->st_ino;
+    checkpoint->offset = 0;
+    checkpoint->utf8 = utf8;
+    info data = { NULL, 0, 0, 0, 0 };
+    checkpoint->data = data;
+    init_count_state(&checkpoint->state);
+}
+
+// The checkpoint is a short text file of "key value" lines. Anything we
+// cannot make sense of is ignored and the file is counted from scratch.
+char load_checkpoint(char *path, checkpoint *checkpoint) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    char key[32];
+    uint64_t value;
+    int fields = 0;
+    int version = 0;
+    while (fscanf(file, "%31s %" SCNu64, key, &value) == 2) {
+        if (str_compare(key, "version")) {
+            version = value;
+        } else if (str_compare(key, "device")) {
+            checkpoint->device = value;
+        } else if (str_compare(key, "inode")) {
+            checkpoint->inode = value;
+        } else if (str_compare(key, "offset")) {
+            checkpoint->offset = value;
+        } else if (str_compare(key, "utf8")) {
+            checkpoint->utf8 = value;
+        } else if (str_compare(key, "lines")) {
+            checkpoint->data.line_count = value;
+        } else if (str_compare(key, "words")) {
+            checkpoint->data.words_count = value;
+        } else if (str_compare(key, "bytes")) {
+            checkpoint->data.byte_count = value;
+        } else if (str_compare(key, "chars")) {
+            checkpoint->data.chars_count = value;
+        } else if (str_compare(key, "prev_ws")) {
+            checkpoint->state.prev_ws = value != 0;
+        } else if (str_compare(key, "utf8_state")) {
+            checkpoint->state.utf8_state = value;
+        } else if (str_compare(key, "codepoint")) {
+            checkpoint->state.codepoint = value;
+        } else {
+            continue;
+        }
+        fields++;
+    }
+    fclose(file);
+    uint32_t utf8_state = checkpoint->state.utf8_state;
+    char valid_state = utf8_state % UTF8_REJECT == 0 && utf8_state != UTF8_REJECT && utf8_state <= UTF8_LAST_STATE;
+    return version == CHECKPOINT_VERSION && fields == 13 && valid_state;
+}
+
+// Written to a temporary file and renamed over the old checkpoint, so an
+// interrupted run never leaves a torn checkpoint behind.
+void save_checkpoint(char *path, checkpoint *checkpoint) {
+    int path_len = str_len(path);
+    char *tmp_path = (char *)malloc(path_len + 5);
+    memcpy(tmp_path, path, path_len);
+    memcpy(tmp_path + path_len, ".tmp", 5);
+    FILE *file = fopen(tmp_path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "ccwc: cannot write checkpoint '%s'\n", path);
+        free(tmp_path);
+        return;
+    }
+    fprintf(file, "version %d\n", CHECKPOINT_VERSION);
+    fprintf(file, "device %" PRIu64 "\n", checkpoint->device);
+    fprintf(file, "inode %" PRIu64 "\n", checkpoint->inode);
+    fprintf(file, "offset %" PRIu64 "\n", checkpoint->offset);
+    fprintf(file, "utf8 %d\n", checkpoint->utf8);
+    fprintf(file, "lines %" PRIu64 "\n", checkpoint->data.line_count);
+    fprintf(file, "words %" PRIu64 "\n", checkpoint->data.words_count);
+    fprintf(file, "bytes %" PRIu64 "\n", checkpoint->data.byte_count);
+    fprintf(file, "chars %" PRIu64 "\n", checkpoint->data.chars_count);
+    fprintf(file, "prev_ws %d\n", checkpoint->state.prev_ws);
+    fprintf(file, "utf8_state %" PRIu32 "\n", checkpoint->state.utf8_state);
+    fprintf(file, "codepoint %" PRIu32 "\n", checkpoint->state.codepoint);
+    if (fclose(file) != 0 || rename(tmp_path, path) != 0) {
+        fprintf(stderr, "ccwc: cannot write checkpoint '%s'\n", path);
+    }
+    free(tmp_path);
+}
+
+void print_checkpoint(checkpoint *checkpoint, char *file_path, int options, int width) {
+    info data = checkpoint->data;
+    count_state state = checkpoint->state;
+    finish_count(&data, &state);
+    data.file_name = file_path;
+    print_info(data, options, width);
+}
+
+// (Re)watches the path, which also picks up a log that was rotated into a
+// new file under the same name.
+int watch_file(int notify_fd, int watch, char *file_path) {
+#ifdef __linux__
+    if (notify_fd < 0) {
+        return -1;
+    }
+    if (watch >= 0) {
+        inotify_rm_watch(notify_fd, watch);
+    }
+    return inotify_add_watch(notify_fd, file_path, IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF);
+#else
+    (void)notify_fd;
+    (void)watch;
+    (void)file_path;
+    return -1;
+#endif
+}
+
+// Blocks until the file may have changed. With inotify we wake on the
+// first event and then sleep out the interval so a burst of writes gives
+// a single update; without it we simply poll once per interval.
+void wait_for_change(int *notify_fd, int *watch, char *file_path, int interval) {
+    if (*watch < 0) {
+        *watch = watch_file(*notify_fd, *watch, file_path);
+    }
+    if (*watch < 0) {
+        sleep(interval);
+        return;
+    }
+#ifdef __linux__
+    struct pollfd pfd = { *notify_fd, POLLIN, 0 };
+    if (poll(&pfd, 1, -1) <= 0) {
+        return;
+    }
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len = read(*notify_fd, events, sizeof(events));
+    for (char *p = events; len > 0 && p < events + len;) {
+        struct inotify_event *event = (struct inotify_event *)p;
+        // A moved file keeps its watch, which would go on waking us for
+        // writes to the rotated-away log; removing it queues an IN_IGNORED
+        // for the old descriptor, which must not drop the new watch.
+        if (event->wd == *watch && (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED))) {
+            if (event->mask & IN_MOVE_SELF) {
+                inotify_rm_watch(*notify_fd, *watch);
+            }
+            *watch = -1;
+        }
+        p += sizeof(struct inotify_event) + event->len;
+    }
+    sleep(interval);
+#endif
 }
 
 char_stream create_char_stream(char *file_path) {
     char_stream stream;
+    if (!open_char_stream(&stream, file_path)) {
+        fprintf(stderr, "ccwc: file '%s' does not exist\n", file_path);
+        exit(0);
+    }
+    return stream;
+}
+
+char open_char_stream(char_stream *stream, char *file_path) {
     if (file_path != NULL) {
-        FILE *file = NULL;
-        file = fopen(file_path, "r");
-        if (file == NULL) {
-            fprintf(stderr, "ccwc: file '%s' does not exist\n", file_path);
-            exit(0);
+        int fd = open(file_path, O_RDONLY);
+        if (fd < 0) {
+            return 0;
         }
-        stream.file_path = file_path;
-        stream.file = file;
+        stream->fd = fd;
     } else {
-        stream.file_path = NULL;
-        stream.file = stdin;
+        stream->fd = STDIN_FILENO;
     }
-    stream.curr = fgetc(stream.file);
-    return stream;
+    stream->file_path = file_path;
+    stream->buffer = NULL;
+    stream->mapped = map_file(stream->fd, &stream->map, &stream->map_len);
+    if (!stream->mapped) {
+        posix_memalign((void **)&stream->buffer, BUFFER_ALIGNMENT, READ_BUFFER_SIZE);
+    }
+    return 1;
 }
 
-char peek_char(char_stream *stream) {
-    return stream->curr;
+// Maps a regular file read at offset zero. Anything else (pipes, terminals,
+// a stdin that was partly consumed) is left to the read path, and so is a
+// file that reports no size: /proc and sysfs files do, yet have content.
+char map_file(int fd, char **map, size_t *len) {
+    struct stat st;
+    *map = NULL;
+    *len = 0;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || lseek(fd, 0, SEEK_CUR) != 0 || st.st_size == 0) {
+        return 0;
+    }
+    void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        return 0;
+    }
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+    *map = (char *)addr;
+    *len = st.st_size;
+    return 1;
 }
 
-char next_char(char_stream *stream) {
-    char res = stream->curr;
-    stream->curr = fgetc(stream->file);
-    return res;
+// Returns the next contiguous run of input, or 0 at the end of the stream.
+// A mapped file is returned whole on the first call.
+size_t next_span(char_stream *stream, const char **span) {
+    if (stream->mapped) {
+        stream->mapped = 0;
+        *span = stream->map;
+        return stream->map_len;
+    }
+    if (stream->buffer == NULL) {
+        return 0;
+    }
+    ssize_t len;
+    do {
+        len = read(stream->fd, stream->buffer, READ_BUFFER_SIZE);
+    } while (len < 0 && errno == EINTR);
+    if (len <= 0) {
+        return 0;
+    }
+    *span = stream->buffer;
+    return len;
 }
 
 void destroy_char_stream(char_stream *stream) {
-    fclose(stream->file);
+    if (stream->map != NULL) {
+        munmap(stream->map, stream->map_len);
+    }
+    free(stream->buffer);
+    if (stream->fd != STDIN_FILENO) {
+        close(stream->fd);
+    }
+}
+
+count_engine create_count_engine(int options) {
+    count_engine engine;
+    engine.count_block = select_count_kernel();
+    engine.utf8 = is_utf8_locale();
+    engine.decode_utf8 = engine.utf8 && (!options || options & (WORDS_COUNT | CHARS_COUNT));
+    return engine;
+}
+
+// Input is taken as UTF-8 unless the locale names another codeset. The C
+// and POSIX locales keep UTF-8, as wc always assumed it.
+char is_utf8_locale() {
+    if (setlocale(LC_CTYPE, "") == NULL) {
+        return 1;
+    }
+    char *codeset = nl_langinfo(CODESET);
+    return str_compare(codeset, "UTF-8") || str_compare(codeset, "utf8") || str_compare(codeset, "ANSI_X3.4-1968");
+}
+
+count_kernel select_count_kernel() {
+#ifdef HAS_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return count_block_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return count_block_sse2;
+    }
+#endif
+    return count_block_scalar;
+}
+
+void init_count_state(count_state *state) {
+    state->prev_ws = 1;
+    state->utf8_state = UTF8_ACCEPT;
+    state->codepoint = 0;
+}
+
+void count_span(count_engine *engine, info *data, count_state *state, const unsigned char *span, size_t len) {
+    if (!engine->decode_utf8) {
+        uint64_t chars_count = data->chars_count;
+        engine->count_block(data, &state->prev_ws, span, len);
+        if (!engine->utf8) {
+            data->chars_count = chars_count + len;
+        }
+        return;
+    }
+    size_t i = 0;
+    while (i < len) {
+        size_t end = i;
+        if (state->utf8_state == UTF8_ACCEPT) {
+            while (end + 64 <= len && is_ascii_group(span + end)) {
+                end += 64;
+            }
+        }
+        if (end > i) {
+            engine->count_block(data, &state->prev_ws, span + i, end - i);
+        } else {
+            end = i + 64 < len ? i + 64 : len;
+            count_utf8(data, state, span + i, end - i);
+        }
+        i = end;
+    }
+}
+
+char is_ascii_group(const unsigned char *span) {
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; i++) {
+        uint64_t word;
+        memcpy(&word, span + i * 8, sizeof(word));
+        bits |= word;
+    }
+    return (bits & ASCII_MASK) == 0;
+}
+
+// Byte classes and transitions of Bjoern Hoehrmann's UTF-8 decoder. States
+// are multiples of 12 so a state plus a class indexes the transitions.
+static const uint8_t utf8_classes[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    8, 8, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    10, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 4, 3, 3, 11, 6, 6, 6, 5, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+};
+
+static const uint8_t utf8_transitions[108] = {
+    0, 12, 24, 36, 60, 96, 84, 12, 12, 12, 48, 72,
+    12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,
+    12, 0, 12, 12, 12, 12, 12, 0, 12, 0, 12, 12,
+    12, 24, 12, 12, 12, 12, 12, 24, 12, 24, 12, 12,
+    12, 12, 12, 12, 12, 12, 12, 24, 12, 12, 12, 12,
+    12, 24, 12, 12, 12, 12, 12, 12, 12, 24, 12, 12,
+    12, 12, 12, 12, 12, 12, 12, 36, 12, 36, 12, 12,
+    12, 36, 12, 12, 12, 12, 12, 36, 12, 36, 12, 12,
+    12, 36, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,
+};
+
+// Decodes a span with the DFA. Only valid characters are counted as
+// characters; an invalid byte, or a sequence cut short, is a single
+// non-whitespace unit, and the byte that cut a sequence short is decoded
+// again from the initial state.
+void count_utf8(info *data, count_state *state, const unsigned char *span, size_t len) {
+    uint32_t utf8_state = state->utf8_state;
+    uint32_t codepoint = state->codepoint;
+    char ws = state->prev_ws;
+    size_t i = 0;
+    while (i < len) {
+        unsigned char c = *(span + i);
+        uint32_t type = *(utf8_classes + c);
+        uint32_t next = *(utf8_transitions + utf8_state + type);
+        if (next == UTF8_REJECT) {
+            data->words_count += ws;
+            ws = 0;
+            if (utf8_state != UTF8_ACCEPT) {
+                utf8_state = UTF8_ACCEPT;
+                continue;
+            }
+            i++;
+            continue;
+        }
+        codepoint = utf8_state != UTF8_ACCEPT ? (c & 0x3Fu) | (codepoint << 6) : (0xFFu >> type) & c;
+        utf8_state = next;
+        if (utf8_state == UTF8_ACCEPT) {
+            char curr_ws = codepoint < 0x80 ? is_whitespace(codepoint) : is_unicode_whitespace(codepoint);
+            data->line_count += c == '\n';
+            data->words_count += ws && !curr_ws;
+            data->chars_count++;
+            ws = curr_ws;
+        }
+        i++;
+    }
+    data->byte_count += len;
+    state->utf8_state = utf8_state;
+    state->codepoint = codepoint;
+    state->prev_ws = ws;
+}
+
+// A sequence still open at the end of the input is invalid.
+void finish_count(info *data, count_state *state) {
+    if (state->utf8_state != UTF8_ACCEPT) {
+        data->words_count += state->prev_ws;
+        state->prev_ws = 0;
+        state->utf8_state = UTF8_ACCEPT;
+    }
+}
+
+char starts_with_whitespace(count_engine *engine, const unsigned char *span, size_t len) {
+    if (!engine->decode_utf8 || *span < 0x80) {
+        return is_whitespace(*span);
+    }
+    uint32_t utf8_state = UTF8_ACCEPT;
+    uint32_t codepoint = 0;
+    for (size_t i = 0; i < len && i < 4; i++) {
+        uint32_t type = *(utf8_classes + *(span + i));
+        codepoint = utf8_state != UTF8_ACCEPT ? (*(span + i) & 0x3Fu) | (codepoint << 6) : (0xFFu >> type) & *(span + i);
+        utf8_state = *(utf8_transitions + utf8_state + type);
+        if (utf8_state == UTF8_ACCEPT) {
+            return is_unicode_whitespace(codepoint);
+        }
+        if (utf8_state == UTF8_REJECT) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+void count_block_scalar(info *data, char *prev_ws, const unsigned char *buffer, size_t len) {
+    char ws = *prev_ws;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = *(buffer + i);
+        char curr_ws = is_whitespace(c);
+        data->line_count += c == '\n';
+        data->words_count += ws && !curr_ws;
+        data->chars_count += (c & 0xC0) != 0x80;
+        ws = curr_ws;
+    }
+    data->byte_count += len;
+    *prev_ws = ws;
+}
+
+// Accumulates the per-byte masks of a 64 byte group. A word is counted at
+// each non-whitespace byte preceded by whitespace, which gives the same
+// total as counting the whitespace that ends each word.
+void count_masks(info *data, char *prev_ws, uint64_t newlines, uint64_t ws, uint64_t chars) {
+    uint64_t starts = ~ws & ((ws << 1) | (uint64_t)*prev_ws);
+    data->line_count += __builtin_popcountll(newlines);
+    data->words_count += __builtin_popcountll(starts);
+    data->chars_count += __builtin_popcountll(chars);
+    data->byte_count += 64;
+    *prev_ws = ws >> 63;
+}
+
+#ifdef HAS_X86_KERNELS
+// Whitespace is ' ' or any byte in '\t'..'\r'; UTF-8 continuation bytes are
+// 0x80..0xBF, which are exactly the signed bytes below -64.
+__attribute__((target("sse2,popcnt")))
+void count_block_sse2(info *data, char *prev_ws, const unsigned char *buffer, size_t len) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i ctrl_range = _mm_set1_epi8('\r' - '\t');
+    const __m128i cont_limit = _mm_set1_epi8(-65);
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        uint64_t newlines = 0, ws = 0, chars = 0;
+        for (int j = 0; j < 4; j++) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(buffer + i + j * 16));
+            __m128i ctrl = _mm_sub_epi8(v, tab);
+            __m128i is_ctrl = _mm_cmpeq_epi8(_mm_min_epu8(ctrl, ctrl_range), ctrl);
+            __m128i is_ws = _mm_or_si128(_mm_cmpeq_epi8(v, space), is_ctrl);
+            newlines |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)) << (j * 16);
+            ws |= (uint64_t)(uint16_t)_mm_movemask_epi8(is_ws) << (j * 16);
+            chars |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpgt_epi8(v, cont_limit)) << (j * 16);
+        }
+        count_masks(data, prev_ws, newlines, ws, chars);
+    }
+    count_block_scalar(data, prev_ws, buffer + i, len - i);
+}
+
+__attribute__((target("avx2,popcnt")))
+void count_block_avx2(info *data, char *prev_ws, const unsigned char *buffer, size_t len) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i ctrl_range = _mm256_set1_epi8('\r' - '\t');
+    const __m256i cont_limit = _mm256_set1_epi8(-65);
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        uint64_t newlines = 0, ws = 0, chars = 0;
+        for (int j = 0; j < 2; j++) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(buffer + i + j * 32));
+            __m256i ctrl = _mm256_sub_epi8(v, tab);
+            __m256i is_ctrl = _mm256_cmpeq_epi8(_mm256_min_epu8(ctrl, ctrl_range), ctrl);
+            __m256i is_ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, space), is_ctrl);
+            newlines |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline)) << (j * 32);
+            ws |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_ws) << (j * 32);
+            chars |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(v, cont_limit)) << (j * 32);
+        }
+        count_masks(data, prev_ws, newlines, ws, chars);
+    }
+    count_block_scalar(data, prev_ws, buffer + i, len - i);
 }
+#endif
 
 char is_option(char *arg) {
     return *arg == '-';
 }
 
-int read_options(int argc, char **argv) {
-    int options = 0;
-    for (int i = 1; i < argc; i++) {
+void read_options(int argc, char **argv, settings *settings) {
+    settings->options = 0;
+    settings->jobs = 1;
+    settings->checkpoint_path = NULL;
+    settings->follow = 0;
+    settings->interval = 1;
+    int i = 1;
+    for (; i < argc && is_option(*(argv + i)); i++) {
         char *arg = *(argv + i);
-        if (!is_option(arg)) {
-            continue;
-        }
-        if (str_compare("-c", arg)) {
-            options |= BYTE_COUNT;
+        if (str_compare("-j", arg) || (*(arg + 1) == 'j' && *(arg + 2) != '\0')) {
+            char *value = str_compare("-j", arg) ? read_value(argc, argv, &i) : arg + 2;
+            settings->jobs = read_number(value, MAX_JOBS);
+            if (settings->jobs < 1) {
+                fprintf(stderr, "ccwc: invalid number of jobs '%s'\n", value);
+                exit(0);
+            }
+        } else if (str_compare("--checkpoint", arg)) {
+            settings->checkpoint_path = read_value(argc, argv, &i);
+        } else if (str_compare("--follow", arg)) {
+            settings->follow = 1;
+        } else if (str_compare("--interval", arg)) {
+            char *value = read_value(argc, argv, &i);
+            settings->interval = read_number(value, MAX_INTERVAL);
+            if (settings->interval < 1) {
+                fprintf(stderr, "ccwc: invalid interval '%s'\n", value);
+                exit(0);
+            }
+        } else if (str_compare("-c", arg)) {
+            settings->options |= BYTE_COUNT;
         } else if (str_compare("-l", arg)) {
-            options |= LINE_COUNT;
+            settings->options |= LINE_COUNT;
         } else if (str_compare("-w", arg)) {
-            options |= WORDS_COUNT;
+            settings->options |= WORDS_COUNT;
         } else if (str_compare("-m", arg)) {
-            options |= CHARS_COUNT;
+            settings->options |= CHARS_COUNT;
         } else {
             fprintf(stderr, "ccwc: invalid option '%s'\n", arg);
             exit(0);
         }
     }
-    return options;
+    settings->files_start = i;
+}
+
+char *read_value(int argc, char **argv, int *i) {
+    if (*i + 1 >= argc) {
+        fprintf(stderr, "ccwc: option '%s' expects a value\n", *(argv + *i));
+        exit(0);
+    }
+    (*i)++;
+    return *(argv + *i);
+}
+
+// Parses a decimal number in [0, max]; returns -1 for anything else.
+int read_number(char *arg, int max) {
+    int number = 0;
+    if (*arg == '\0') {
+        return -1;
+    }
+    for (char *c = arg; *c != '\0'; c++) {
+        if (*c < '0' || *c > '9') {
+            return -1;
+        }
+        number = number * 10 + (*c - '0');
+        if (number > max) {
+            return -1;
+        }
+    }
+    return number;
 }
 
 int str_len(char *str) {
@@ -199,47 +1072,66 @@ char str_compare(char *str1, char *str2) {
 }
 
 char is_whitespace(char c) {
-    char whitespaces[] = {' ', '\t', '\n', '\v', '\f', '\r', EOF};
-    for (int i = 0; i < 7; i++) {
-        if (c == *(whitespaces + i)) {
-            return 1;
-        }
-    }
-    return 0;
+    return c == ' ' || (c >= '\t' && c <= '\r');
 }
 
-int count_digits(int n) {
-    if (n == 0) {
-        return 0;
-    }
-    unsigned int count = 0;
-    while (n != 0) {
+// The characters with the Unicode White_Space property outside ASCII.
+char is_unicode_whitespace(uint32_t c) {
+    return c == 0x85 || c == 0xA0 || c == 0x1680 || (c >= 0x2000 && c <= 0x200A) || c == 0x2028 || c == 0x2029 || c == 0x202F || c == 0x205F || c == 0x3000;
+}
+
+int count_digits(uint64_t n) {
+    int count = 1;
+    while (n >= 10) {
         count++;
         n = n / 10;
     }
     return count;
 }
 
-void print_value(int value) {
-    int digits_count = count_digits(value);
-    for (int i = 0; i < PAD - digits_count; i++) {
+// Every count is bounded by the byte count, so the combined size of the
+// regular files bounds every value we will print, totals included. The
+// files are only stat'ed here; counting may start printing before the last
+// one is read, so the width has to be known up front.
+int column_width(int count, char **file_paths) {
+    uint64_t size = 0;
+    for (int i = 0; i < count; i++) {
+        struct stat st;
+        char *file_path = *(file_paths + i);
+        if (file_path != NULL && stat(file_path, &st) == 0 && S_ISREG(st.st_mode)) {
+            size += st.st_size;
+        }
+    }
+    int width = count_digits(size) + 1;
+    return width > PAD ? width : PAD;
+}
+
+// Right-aligns the value in width columns, always leaving at least one
+// space before it: stdin's size is unknown, so its counts can outgrow the
+// width.
+void print_value(uint64_t value, int width) {
+    int padding = width - count_digits(value);
+    if (padding < 1) {
+        padding = 1;
+    }
+    for (int i = 0; i < padding; i++) {
         printf(" ");
     }
-    printf("%d", value);
+    printf("%" PRIu64, value);
 }
 
-void print_info(info data, int options) {
+void print_info(info data, int options, int width) {
     if (!options || options & LINE_COUNT) {
-        print_value(data.line_count);
+        print_value(data.line_count, width);
     }
     if (!options || options & WORDS_COUNT) {
-        print_value(data.words_count);
+        print_value(data.words_count, width);
     }
     if (!options || options & BYTE_COUNT) {
-        print_value(data.byte_count);
+        print_value(data.byte_count, width);
     }
     if (options & CHARS_COUNT) {
-        print_value(data.chars_count);
+        print_value(data.chars_count, width);
     }
     if (data.file_name != NULL) {
         printf(" %s\n", data.file_name);
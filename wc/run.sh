@@ -1,3 +1,3 @@
 mkdir -p bin
-clang main.c -o bin/wc
+clang -O2 main.c -o bin/wc -pthread
 ./bin/wc "$@"
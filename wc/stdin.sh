@@ -0,0 +1,20 @@
+# Pipes input into wc through stdin, where the size is unknown and the
+# columns keep the default width, and checks that every count is still
+# separated from the next: the fields must match the system's wc.
+mkdir -p bin
+clang -O2 main.c -o bin/wc -pthread
+failed=0
+for lines in 3 12000000; do
+    for options in "" "-l" "-w" "-c" "-l -w -c"; do
+        expected=$(yes | head -n "$lines" | wc $options | awk '{$1 = $1; print}')
+        got=$(yes | head -n "$lines" | ./bin/wc $options | awk '{$1 = $1; print}')
+        if [ "$got" != "$expected" ]; then
+            echo "wc $options on $lines piped lines printed '$got', expected '$expected'"
+            failed=1
+        fi
+    done
+done
+if [ "$failed" = 0 ]; then
+    echo "all counts agree"
+fi
+exit "$failed"